@@ -0,0 +1,58 @@
+#ifndef __ACCOUNTING_H_
+#define __ACCOUNTING_H_
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+enum AccountingStatus : uint8_t {AccountOk, AccountExceedsSystem, AccountExceedsProcess, AccountExceedsGroup};
+
+// A limit of 0 means unlimited
+typedef struct Account {
+    uint64_t committed; // bytes up to the end of the process' last variable
+    int64_t frames;     // mapped pages (RSS), so a shared frame counts once for every process mapping it
+    uint64_t limit;
+    std::string group;
+} Account;
+
+typedef struct AccountGroup {
+    uint64_t committed;
+    int64_t frames;     // sum of the members' mapped pages
+    uint64_t limit;
+    int members;
+} AccountGroup;
+
+// Committed bytes and frames per process, per group and for the whole system. Every
+// counter is updated as memory is charged or released, so admission checks are O(1).
+// Process and group frames count mappings; the system counts each frame in use once.
+class Accounting {
+private:
+    uint64_t _system_limit;
+    uint64_t _committed;
+    int64_t _frames; // frames in use, however many processes map them
+    std::unordered_map<uint32_t, Account> _accounts;
+    std::unordered_map<std::string, AccountGroup> _groups;
+
+public:
+    Accounting(uint64_t system_limit);
+    ~Accounting();
+
+    void addProcess(uint32_t pid);
+    void removeProcess(uint32_t pid);
+    AccountingStatus check(uint32_t pid, uint64_t bytes);
+    AccountingStatus charge(uint32_t pid, uint64_t bytes);
+    void uncharge(uint32_t pid, uint64_t bytes);
+    void chargeFrames(uint32_t pid, int frames);
+    void claimFrames(int frames);
+    void setSystemLimit(uint64_t limit);
+    bool setProcessLimit(uint32_t pid, uint64_t limit);
+    void setGroupLimit(std::string group, uint64_t limit);
+    bool joinGroup(uint32_t pid, std::string group);
+    std::string statusMessage(AccountingStatus status, uint32_t pid);
+    uint64_t getCommitted();
+    int64_t getFrames();
+    void print(std::ostream& out);
+};
+
+#endif // __ACCOUNTING_H_
@@ -0,0 +1,94 @@
+#ifndef __CACHE_H_
+#define __CACHE_H_
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+enum CacheReplacement : uint8_t {ReplaceLru, ReplaceFifo, ReplaceRandom};
+
+// The TLB is modelled like a cache level whose lines are (pid, page) translations
+enum CacheLevelId : uint8_t {LevelTlb, LevelL1, LevelL2, LevelLlc, NumCacheLevels};
+
+// One set-associative structure. Keys are line numbers, or page numbers for the TLB, whose
+// lines are also tagged with the pid they translate for, like an ASID.
+class CacheLevel {
+private:
+    typedef struct CacheLine {
+        uint64_t key;
+        uint32_t pid;   // 0 for physical lines
+        uint64_t stamp; // last use for LRU, fill time for FIFO
+        bool valid;
+    } CacheLine;
+
+    uint32_t _sets;
+    uint32_t _ways;
+    CacheReplacement _replacement;
+    std::vector<CacheLine> _lines; // set-major, _ways lines per set
+    uint64_t _clock;
+    uint64_t _random_state;
+
+public:
+    uint64_t size;
+    uint32_t line_size;
+    uint32_t latency;
+    uint64_t hits;
+    uint64_t misses;
+
+    CacheLevel(uint64_t size, uint32_t ways, uint32_t line_size, uint32_t latency, CacheReplacement replacement);
+
+    // Returns true on a hit; on a miss the key is filled in, evicting a victim if needed
+    bool lookup(uint64_t key, uint32_t pid = 0);
+    void invalidate(uint64_t key, uint32_t pid = 0);
+    uint32_t getWays();
+    CacheReplacement getReplacement();
+};
+
+typedef struct CacheProcessStats {
+    uint64_t hits[NumCacheLevels];
+    uint64_t misses[NumCacheLevels];
+    uint64_t accesses; // cache line accesses
+    uint64_t cycles;
+} CacheProcessStats;
+
+// Optional model of a TLB and up to three cache levels fed by the physical accesses of
+// MemoryAccess. Each level is looked up in its own line size, and a miss in the last
+// configured level costs the access cost of the memory node holding the frame. Accesses
+// are counted per line of the first level touched, so a bulk operation over one line is a
+// single access.
+class CacheHierarchy {
+private:
+    int _page_size;
+    CacheLevel *_levels[NumCacheLevels];
+    uint32_t _walk_cost; // extra cost of a TLB miss
+    uint64_t _accesses;
+    uint64_t _cycles;
+    std::unordered_map<uint32_t, CacheProcessStats> _processes;
+
+    void resetCounters();
+    uint64_t accessLines(int level, uint64_t address, uint64_t bytes, uint32_t memory_cost, CacheProcessStats& proc);
+
+public:
+    CacheHierarchy(int page_size);
+    ~CacheHierarchy();
+
+    // Reconfiguring any level empties every level and resets all counters
+    void setLevel(CacheLevelId level, CacheLevel *cache);
+    void setWalkCost(uint32_t walk_cost);
+    void disable();
+    bool isEnabled();
+
+    // One page-contiguous run of bytes
+    void access(uint32_t pid, uint64_t virtual_address, uint64_t physical_address, size_t bytes, uint32_t memory_cost);
+    // Drops a cached translation once the page is unmapped or moved to another frame
+    void invalidate(uint32_t pid, uint64_t page_number);
+    void print(std::ostream& out);
+};
+
+bool cacheLevelFromName(std::string_view name, CacheLevelId& level);
+bool cacheReplacementFromName(std::string_view name, CacheReplacement& replacement);
+
+#endif // __CACHE_H_
@@ -0,0 +1,60 @@
+#ifndef __COMMAND_H_
+#define __COMMAND_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <type_traits>
+#include "stats.h"
+#include "memsim.h"
+
+// Everything a command handler may touch; the simulated machine is only reached through sim
+typedef struct CommandContext {
+    Simulator *sim;
+} CommandContext;
+
+typedef std::vector<std::string_view> TokenList;
+
+// args[0] is the command name itself
+typedef void (*CommandHandler)(const TokenList& args, CommandContext *ctx);
+
+typedef struct CommandSpec {
+    const char *name;
+    StatCommand stat;
+    size_t min_args; // including the command name
+    const char *usage;
+    CommandHandler handler;
+} CommandSpec;
+
+// Split a line into views over the caller's buffer. `tokens` is cleared first and can be
+// reused between lines so steady-state tokenizing allocates nothing.
+void tokenize(std::string_view line, TokenList& tokens);
+
+// Find the spec whose name matches, or NULL
+const CommandSpec* findCommand(const CommandSpec *table, size_t table_size, std::string_view name);
+
+bool dataTypeFromName(std::string_view name, DataType& type);
+
+// Parse one token into a typed value without allocating. A char takes the token's first
+// character; numbers must use the whole token.
+template <typename T>
+bool parseValue(std::string_view token, T& value)
+{
+    if (token.empty()) {
+        return false;
+    }
+    if constexpr (std::is_same<T, char>::value) {
+        value = token[0];
+        return true;
+    } else {
+        if (token[0] == '+') { // from_chars does not accept a leading plus
+            token.remove_prefix(1);
+        }
+        const char *end = token.data() + token.size();
+        std::from_chars_result result = std::from_chars(token.data(), end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+}
+
+#endif // __COMMAND_H_
@@ -0,0 +1,18 @@
+#ifndef __LZ_H_
+#define __LZ_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A small LZ77 codec in the style of LZ4 for compressing page contents. A stream is a run
+// of sequences: a token byte (literal count in the high nibble, match length minus 4 in
+// the low nibble, 15 meaning "more length bytes follow"), the literals, then a 2-byte
+// little-endian match offset. The last sequence has literals only.
+
+// Returns the compressed size, or 0 if the result would not fit in dst_capacity
+size_t lzCompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity);
+
+// Returns false if the stream is malformed or does not decode to exactly dst_size bytes
+bool lzDecompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
+
+#endif // __LZ_H_
@@ -0,0 +1,185 @@
+#ifndef __MEMACCESS_H_
+#define __MEMACCESS_H_
+
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <stdint.h>
+#include "mmu.h"
+#include "pagetable.h"
+#include "cache.h"
+
+// Call f with a default-constructed value of the C++ type behind a DataType, so callers
+// branch on the type once and then run typed code
+template <typename F>
+auto dispatchDataType(DataType type, F&& f)
+{
+    switch (type) {
+        case Short:  return f(short());
+        case Int:    return f(int());
+        case Float:  return f(float());
+        case Long:   return f(long());
+        case Double: return f(double());
+        default:     return f(char());
+    }
+}
+
+// The DataType whose values are of C++ type T
+template <typename T>
+constexpr DataType dataTypeOf()
+{
+    if constexpr (std::is_same<T, short>::value) {
+        return Short;
+    } else if constexpr (std::is_same<T, int>::value) {
+        return Int;
+    } else if constexpr (std::is_same<T, float>::value) {
+        return Float;
+    } else if constexpr (std::is_same<T, long>::value) {
+        return Long;
+    } else if constexpr (std::is_same<T, double>::value) {
+        return Double;
+    } else {
+        static_assert(std::is_same<T, char>::value, "no DataType for this type");
+        return Char;
+    }
+}
+
+inline uint32_t dataTypeSize(DataType type)
+{
+    return dispatchDataType(type, [](auto value) { return (uint32_t)sizeof(value); });
+}
+
+// Typed bulk access to simulated memory. Each operation translates once per page and then
+// works on the run of bytes that is contiguous in that page; only an element that
+// straddles two pages is assembled byte by byte. Every run is also fed to the cache model
+// when one is configured.
+class MemoryAccess {
+private:
+    PageTable *_page_table;
+    uint8_t *_memory;
+    CacheHierarchy *_cache;
+
+    // Call f(physical pointer, length) for each page-contiguous run of [virtual_address,
+    // virtual_address + bytes). Fails without calling f again at the first unmapped page.
+    template <typename F>
+    bool forEachRun(uint32_t pid, uint64_t virtual_address, size_t bytes, bool write, F&& f)
+    {
+        uint32_t page_size = _page_table->getPageSize();
+        size_t done = 0;
+        while (done < bytes) {
+            uint64_t address = virtual_address + done;
+            int64_t physical = _page_table->getPhysicalAddress(pid, address, write);
+            if (physical < 0) {
+                return false;
+            }
+            size_t length = std::min(bytes - done, (size_t)(page_size - address % page_size));
+            if (_cache != NULL && _cache->isEnabled()) {
+                uint32_t cost = _page_table->getNuma()->accessCost(pid, physical / page_size);
+                _cache->access(pid, address, physical, length, cost);
+            }
+            f(_memory + physical, length);
+            done += length;
+        }
+        return true;
+    }
+
+public:
+    MemoryAccess(PageTable *page_table, void *memory, CacheHierarchy *cache = NULL)
+        : _page_table(page_table), _memory((uint8_t*)memory), _cache(cache) {}
+
+    bool readBytes(uint32_t pid, uint64_t virtual_address, void *dst, size_t bytes)
+    {
+        uint8_t *out = (uint8_t*)dst;
+        return forEachRun(pid, virtual_address, bytes, false, [&](uint8_t *run, size_t length) {
+            memcpy(out, run, length);
+            out += length;
+        });
+    }
+
+    bool writeBytes(uint32_t pid, uint64_t virtual_address, const void *src, size_t bytes)
+    {
+        const uint8_t *in = (const uint8_t*)src;
+        return forEachRun(pid, virtual_address, bytes, true, [&](uint8_t *run, size_t length) {
+            memcpy(run, in, length);
+            in += length;
+        });
+    }
+
+    template <typename T>
+    bool read(uint32_t pid, uint64_t virtual_address, T *dst, size_t count)
+    {
+        return readBytes(pid, virtual_address, dst, count * sizeof(T));
+    }
+
+    template <typename T>
+    bool write(uint32_t pid, uint64_t virtual_address, const T *src, size_t count)
+    {
+        return writeBytes(pid, virtual_address, src, count * sizeof(T));
+    }
+
+    template <typename T>
+    bool fill(uint32_t pid, uint64_t virtual_address, T value, size_t count)
+    {
+        if constexpr (sizeof(T) == 1) {
+            return forEachRun(pid, virtual_address, count, true, [&](uint8_t *run, size_t length) {
+                memset(run, (uint8_t)value, length);
+            });
+        } else {
+            uint8_t pattern[sizeof(T)];
+            memcpy(pattern, &value, sizeof(T));
+            size_t phase = 0; // byte of the current element the next run starts at
+            return forEachRun(pid, virtual_address, count * sizeof(T), true, [&](uint8_t *run, size_t length) {
+                size_t i = 0;
+                for (; phase != 0 && i < length; i++) {
+                    run[i] = pattern[phase];
+                    phase = (phase + 1) % sizeof(T);
+                }
+                size_t elements = (length - i) / sizeof(T);
+                for (size_t e = 0; e < elements; e++) {
+                    memcpy(run + i + e * sizeof(T), pattern, sizeof(T));
+                }
+                i += elements * sizeof(T);
+                for (; i < length; i++) {
+                    run[i] = pattern[phase];
+                    phase = (phase + 1) % sizeof(T);
+                }
+            });
+        }
+    }
+
+    // Adds count elements starting at virtual_address into total
+    template <typename T, typename Total>
+    bool sum(uint32_t pid, uint64_t virtual_address, size_t count, Total& total)
+    {
+        uint8_t carry[sizeof(T)];
+        size_t carried = 0; // bytes of an element that straddles pages
+        return forEachRun(pid, virtual_address, count * sizeof(T), false, [&](uint8_t *run, size_t length) {
+            T value;
+            size_t i = 0;
+            if (carried != 0) {
+                i = std::min(sizeof(T) - carried, length);
+                memcpy(carry + carried, run, i);
+                carried += i;
+                if (carried == sizeof(T)) {
+                    memcpy(&value, carry, sizeof(T));
+                    total += value;
+                    carried = 0;
+                }
+            }
+            size_t elements = (length - i) / sizeof(T);
+            Total run_total = 0;
+            for (size_t e = 0; e < elements; e++) {
+                memcpy(&value, run + i + e * sizeof(T), sizeof(T));
+                run_total += value;
+            }
+            total += run_total;
+            i += elements * sizeof(T);
+            if (i < length) {
+                memcpy(carry, run + i, length - i);
+                carried = length - i;
+            }
+        });
+    }
+};
+
+#endif // __MEMACCESS_H_
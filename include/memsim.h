@@ -0,0 +1,186 @@
+#ifndef __MEMSIM_H_
+#define __MEMSIM_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "mmu.h"
+#include "pagetable.h"
+#include "accounting.h"
+#include "numa.h"
+#include "cache.h"
+#include "memaccess.h"
+#include "shm.h"
+
+// libmemsim: the whole simulated machine behind one object. Operations return a status
+// and hand results back through out parameters; only the print methods write anything,
+// to the stream they are given. Element offsets and counts are in elements of the
+// variable's type.
+enum SimStatus : uint8_t {
+    SimOk,
+    SimProcessNotFound,
+    SimVariableNotFound,
+    SimVariableExists,
+    SimSegmentNotFound,
+    SimSegmentExists,
+    SimSegmentAttached,
+    SimNotShared,
+    SimOutOfVirtualSpace,
+    SimOutOfFrames,
+    SimBadAddress,    // a page of the variable is unmapped, or could not be brought back into a frame
+    SimExceedsSystem,
+    SimExceedsProcess,
+    SimExceedsGroup,
+    SimIndexOutOfRange,
+    SimTypeMismatch,
+    SimInvalidNode,
+    SimNodeNotFound,
+    SimInvalidCacheSize,
+    SimInvalidScanInterval,
+    SimTooManyLevels,
+    SimInvalidLevelBits,
+    SimAddressSpaceTooLarge,
+    SimPagesMapped,
+    SimInvalidPageSize,
+    SimOutOfMemory    // the host could not provide the simulated physical memory
+};
+
+class Simulator {
+private:
+    int _page_size;
+    NumaMemory *_numa;
+    uint8_t *_memory;
+    Accounting *_accounting;
+    Mmu *_mmu;
+    PageTable *_page_table;
+    CacheHierarchy *_cache;
+    MemoryAccess *_access;
+    SharedMemory *_shm;
+
+    SimStatus placeVariable(uint32_t pid, const std::string& name, DataType type, uint64_t count, uint64_t *address);
+    SimStatus checkAccess(uint32_t pid, const std::string& name, DataType type, uint64_t offset, uint64_t count, Variable **var);
+
+public:
+    // A page size that is not positive is reported by addNode and init
+    Simulator(int page_size);
+    ~Simulator();
+
+    // Nodes can only be added before init, which falls back to one 64 MB node
+    SimStatus addNode(uint64_t bytes, uint32_t local_cost, uint32_t remote_cost);
+    SimStatus init();
+
+    SimStatus createProcess(uint64_t text_size, uint64_t data_size, uint32_t *pid);
+    SimStatus allocate(uint32_t pid, const std::string& name, DataType type, uint64_t count, uint64_t *address);
+    SimStatus freeVariable(uint32_t pid, const std::string& name);
+    SimStatus terminate(uint32_t pid);
+    SimStatus findVariable(uint32_t pid, const std::string& name, Variable **var);
+    SimStatus copy(uint32_t src_pid, const std::string& src_name, uint32_t dst_pid, const std::string& dst_name);
+    SimStatus createSegment(const std::string& name, DataType type, uint64_t size);
+    SimStatus attachSegment(uint32_t pid, const std::string& name, uint64_t *address);
+    SimStatus detachSegment(uint32_t pid, const std::string& name);
+    // Only a segment that no process has attached can be destroyed
+    SimStatus destroySegment(const std::string& name);
+    std::string statusMessage(SimStatus status, uint32_t pid);
+
+    // Limits are in bytes of committed memory, 0 for unlimited
+    SimStatus setSystemLimit(uint64_t bytes);
+    SimStatus setGroupLimit(const std::string& group, uint64_t bytes);
+    SimStatus setProcessLimit(uint32_t pid, uint64_t bytes);
+    SimStatus joinGroup(uint32_t pid, const std::string& group);
+
+    // A node of -1 keeps the process' home node
+    SimStatus setPolicy(uint32_t pid, NumaPolicy policy, int node);
+    SimStatus migrate(uint32_t pid, int node, int *moved);
+
+    // Reconfiguring any level empties every level and resets the cache counters
+    SimStatus configureCache(CacheLevelId level, uint64_t size, uint32_t ways, uint32_t line_size, uint32_t latency, CacheReplacement replacement);
+    SimStatus configureTlb(uint64_t entries, uint32_t ways, uint32_t latency, uint32_t walk_cost, CacheReplacement replacement);
+    void disableCache();
+
+    SimStatus setTracking(bool tracking, uint64_t window, uint64_t interval);
+    // Merges identical frames in one full pass; returns the number of pages merged
+    int dedupPass();
+    // Pages the dedup scanner looks at in every backgroundWork call, 0 for none
+    void setDedupBackground(size_t pages);
+    void backgroundWork();
+    // Pool size for compressed pages, 0 to stop compressing
+    void setZswapLimit(size_t bytes);
+    // Root level first; only while no pages are mapped
+    SimStatus setGeometry(const std::vector<int>& bits);
+
+    void printMmu(std::ostream& out);
+    // pid is ALL_PROCESSES for every process' entries
+    void printPageTable(uint32_t pid, size_t start, size_t count, std::ostream& out);
+    void printProcesses(std::ostream& out);
+    void printMemStat(std::ostream& out);
+    void printAccounting(std::ostream& out);
+    void printSharedMemory(std::ostream& out);
+    SimStatus printHeat(uint32_t pid, std::ostream& out);
+    void printZswap(std::ostream& out);
+    void printGeometry(std::ostream& out);
+    void printDedup(std::ostream& out);
+    void printWorkingSets(std::ostream& out);
+    void printCache(std::ostream& out);
+    void printNuma(std::ostream& out);
+
+    // T must be the C++ type of the variable's data type
+    template <typename T>
+    SimStatus write(uint32_t pid, const std::string& name, uint64_t offset, const T *values, size_t count)
+    {
+        Variable *var;
+        SimStatus status = checkAccess(pid, name, dataTypeOf<T>(), offset, count, &var);
+        if (status != SimOk) {
+            return status;
+        }
+        return _access->write(pid, var->virtual_address + offset * sizeof(T), values, count) ? SimOk : SimBadAddress;
+    }
+
+    template <typename T>
+    SimStatus read(uint32_t pid, const std::string& name, uint64_t offset, T *values, size_t count)
+    {
+        Variable *var;
+        SimStatus status = checkAccess(pid, name, dataTypeOf<T>(), offset, count, &var);
+        if (status != SimOk) {
+            return status;
+        }
+        return _access->read(pid, var->virtual_address + offset * sizeof(T), values, count) ? SimOk : SimBadAddress;
+    }
+
+    template <typename T>
+    SimStatus fill(uint32_t pid, const std::string& name, uint64_t offset, size_t count, T value)
+    {
+        Variable *var;
+        SimStatus status = checkAccess(pid, name, dataTypeOf<T>(), offset, count, &var);
+        if (status != SimOk) {
+            return status;
+        }
+        return _access->fill(pid, var->virtual_address + offset * sizeof(T), value, count) ? SimOk : SimBadAddress;
+    }
+
+    // Adds every element of the variable into total
+    template <typename T, typename Total>
+    SimStatus sum(uint32_t pid, const std::string& name, Total& total)
+    {
+        Variable *var;
+        SimStatus status = checkAccess(pid, name, dataTypeOf<T>(), 0, 0, &var);
+        if (status != SimOk) {
+            return status;
+        }
+        return _access->sum<T>(pid, var->virtual_address, var->size / sizeof(T), total) ? SimOk : SimBadAddress;
+    }
+
+    // Walks the page table, bringing a compressed page back into a frame; the caches are not used
+    SimStatus translate(uint32_t pid, uint64_t virtual_address, uint64_t *physical_address);
+    // Compresses up to pages cold pages into the zswap pool; returns the number of frames freed
+    int reclaimFrames(int pages);
+
+    int getPageSize();
+    // Bytes of simulated physical memory, over every node
+    uint64_t getMemorySize();
+    // Frames in use, each counted once however many pages map it
+    int getFrameCount();
+    int getMergedFrameCount();
+    int getEntryCount(uint32_t pid);
+};
+
+#endif // __MEMSIM_H_
@@ -4,43 +4,68 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <set>
+#include <utility>
+#include "accounting.h"
 
 enum DataType : uint8_t {FreeSpace, Char, Short, Int, Float, Long, Double};
 
 typedef struct Variable {
     std::string name;
     DataType type;
-    uint32_t virtual_address;
-    uint32_t size;
+    uint64_t virtual_address;
+    uint64_t size;
+    bool alignment_hole; // <FREE_SPACE> inserted by allocateVariable to align a variable
+    bool shared;         // mapping of a shared memory segment
 } Variable;
 
+// Fragmentation and residency metrics, kept up to date on every change so reading them is O(1)
+typedef struct MemStat {
+    uint64_t virtual_bytes;                // bytes held by variables (including <TEXT>, <GLOBALS>, <STACK>)
+    uint64_t alignment_hole_bytes;         // internal fragmentation
+    std::multiset<uint64_t> free_segments; // sizes of holes between variables (trailing free space excluded)
+} MemStat;
+
 typedef struct Process {
     uint32_t pid;
     std::vector<Variable*> variables;
+    MemStat stat;
 } Process;
 
 class Mmu {
 private:
     uint32_t _next_pid;
-    uint32_t _max_size;
+    uint64_t _max_size; // virtual address space of each new process
     std::vector<Process*> _processes;
+    MemStat _global_stat;
+    Accounting *_accounting;
+
+    Process* findProcess(uint32_t pid);
+    void trackFreeSegment(Process *proc, int idx, bool insert);
 
 public:
-    Mmu(int memory_size);
+    Mmu(uint64_t memory_size, Accounting *accounting);
     ~Mmu();
 
     uint32_t createProcess();
-    void addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint32_t size, uint32_t address, int idxToInsert);
-    void print();
+    AccountingStatus checkAllocation(uint32_t pid, uint64_t size, int idxToInsert);
+    AccountingStatus addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint64_t size, uint64_t address, int idxToInsert);
+    void print(std::ostream& out);
+    // These two return FreeSpace and NULL for a variable the process does not have
     DataType getVariableType(uint32_t pid, std::string var_name);
+    Variable* findVariable(uint32_t pid, std::string var_name);
     bool doWeHaveProcess(uint32_t pid);
     bool doWeHaveVariable(uint32_t pid, std::string var_name);
-    Variable* findVariable(uint32_t pid, std::string var_name);
     std::vector<Variable*> getVariableList(uint32_t pid);
-    void printProcesses();
+    void printProcesses(std::ostream& out);
     void removeVariableFromProcess(uint32_t pid, std::string var_name);
-    std::vector<int> mergeFreeSpace(uint32_t pid, int page_size);
+    std::vector<std::pair<uint64_t, uint64_t>> mergeFreeSpace(uint32_t pid, int page_size);
     void removeProcessFromMmu(uint32_t pid);
+    std::vector<uint32_t> getProcessIds();
+    const MemStat& getMemStat(uint32_t pid);
+    const MemStat& getGlobalMemStat();
+    Accounting* getAccounting();
+    void setVirtualSize(uint64_t size);
 };
 
 #endif // __MMU_H_
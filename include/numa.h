@@ -0,0 +1,72 @@
+#ifndef __NUMA_H_
+#define __NUMA_H_
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <stdint.h>
+
+enum NumaPolicy : uint8_t {PolicyLocal, PolicyInterleave, PolicyBind};
+
+// A node owns the contiguous frames [first_frame, first_frame + frame_count) of physical memory
+typedef struct NumaNode {
+    int first_frame;
+    int frame_count;
+    uint32_t local_cost;           // simulated cost of an access from a process homed on this node
+    uint32_t remote_cost;          // ... and from a process homed anywhere else
+    int next_frame;                // frames below this have been handed out at least once
+    std::set<int> released_frames; // freed frames below next_frame, lowest reused first
+    int frames_in_use;
+    uint64_t local_accesses;
+    uint64_t remote_accesses;
+    uint64_t access_cost;
+} NumaNode;
+
+typedef struct NumaProcess {
+    NumaPolicy policy;
+    int home;            // preferred node for local, the only node for bind
+    int next_interleave; // node the next interleaved page goes to
+} NumaProcess;
+
+// Splits physical memory into nodes with their own frame pools and access costs, and
+// places each process' frames according to its policy. A process is homed on the nodes
+// round-robin the first time it gets a frame or a policy; queries never assign a home.
+class NumaMemory {
+private:
+    int _page_size;
+    std::vector<NumaNode> _nodes;
+    std::vector<int> _fallback; // node indices by increasing remote cost
+    std::unordered_map<uint32_t, NumaProcess> _processes;
+    int _next_home;
+
+    NumaProcess& process(uint32_t pid);
+    NumaProcess lookUpProcess(uint32_t pid);
+    int freeFrames(int node);
+
+public:
+    NumaMemory(int page_size);
+    ~NumaMemory();
+
+    bool addNode(uint64_t bytes, uint32_t local_cost, uint32_t remote_cost);
+    int getNodeCount();
+    int getFrameCount();
+    uint64_t getMemorySize();
+
+    // Return -1 when the process' policy leaves no node with a free frame. Frames not
+    // owned by any process (pid ALL_PROCESSES) go to the cheapest node with room.
+    int allocateFrame(uint32_t pid);
+    int allocateFrameOnNode(int node);
+    void releaseFrame(int frame);
+    int freeFramesFor(uint32_t pid);
+    int nodeOf(int frame);
+
+    uint32_t accessCost(uint32_t pid, int frame);
+    void recordAccess(uint32_t pid, int frame);
+    bool setPolicy(uint32_t pid, NumaPolicy policy, int node);
+    void setHomeNode(uint32_t pid, int node);
+    void removeProcess(uint32_t pid);
+    void print(std::ostream& out);
+};
+
+#endif // __NUMA_H_
@@ -0,0 +1,10 @@
+#ifndef __OUTPUT_H_
+#define __OUTPUT_H_
+
+#include <ostream>
+
+// printf onto a stream rather than stdout, so formatted output goes wherever the caller's
+// print method was pointed, e.g. a server session's std::cout
+void streamPrintf(std::ostream& out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif // __OUTPUT_H_
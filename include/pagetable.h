@@ -5,41 +5,141 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <stdint.h>
+#include "accounting.h"
+#include "numa.h"
+#include "zswap.h"
+#include "cache.h"
 
-struct PageTableKeyComparator
+// Entries are keyed by (pid, page number), so the map keeps them ordered by pid and then by
+// page and every process' pages form one contiguous range
+typedef std::pair<uint32_t, uint64_t> PageKey;
+
+inline PageKey pageTableKey(uint32_t pid, uint64_t page_number)
 {
-    inline bool operator() (const std::string& str1, const std::string& str2)
-    {
-        size_t sep1 = str1.find("|");
-        uint32_t pid1 = std::stoi(str1.substr(0, sep1));
-        int page1 = std::stoi(str1.substr(sep1 + 1));
-        size_t sep2 = str2.find("|");
-        uint32_t pid2 = std::stoi(str2.substr(0, sep2));
-        int page2 = std::stoi(str2.substr(sep2 + 1));
-
-        return (pid1 < pid2 || (pid1 == pid2 && page1 < page2));
-    }
-};
+    return PageKey(pid, page_number);
+}
+
+const uint32_t ALL_PROCESSES = UINT32_MAX;
+
+// Limits on the page-table geometry; 48 bits of page number cover 60-bit addresses with
+// 4 KB pages
+const int MAX_PAGE_TABLE_LEVELS = 6;
+const int PAGE_NUMBER_BITS = 48;
+
+// 64 MB: the virtual address space of a process until the geometry is changed, and the
+// size of the memory node used when none is given
+const uint64_t DEFAULT_MEMORY_SIZE = 67108864;
+
+// Access tracking bits. Time is counted in tracked translations.
+typedef struct PageEntry {
+    int frame;
+    bool referenced;   // translated since the last working-set scan
+    bool dirty;        // written since it was mapped
+    bool compressed;   // in the zswap pool, with no frame until it is next accessed
+    bool in_working_set; // counted in its process' working set as of the hand's last visit
+    uint32_t accesses;
+    uint64_t last_use; // time of the last tracked translation, or of mapping
+} PageEntry;
+
+typedef struct DedupStats {
+    uint64_t passes;        // complete passes over the page table
+    uint64_t pages_scanned;
+    uint64_t bytes_hashed;
+    uint64_t comparisons;   // byte-for-byte checks of candidates with equal hashes
+    uint64_t pages_merged;
+    uint64_t cow_breaks;    // writes that split a merged frame again
+    uint64_t scan_ns;
+} DedupStats;
 
 class PageTable {
 private:
     int _page_size;
-    std::map<std::string, int> _table;
+    std::map<PageKey, PageEntry> _table;
+    std::unordered_map<uint32_t, int> _process_entries;
+    Accounting *_accounting;
+    NumaMemory *_numa;            // owns the free frames and decides where new ones go
+    std::vector<int> _frame_refs; // page table entries (and shared segments) using each frame
+    int _frames_in_use;
+    bool _tracking;
+    uint64_t _clock;
+    uint64_t _next_scan;
+    uint64_t _wss_window;   // pages used within this many ticks are in the working set
+    uint64_t _scan_interval;
+    std::unordered_map<uint32_t, int> _working_sets;
+    PageKey _wss_cursor;             // WSClock hand
+    uint8_t *_memory;
+    std::vector<bool> _frame_merged; // merged by dedup, so written only after a copy
+    std::unordered_multimap<uint64_t, int> _dedup_candidates; // content hash to frame, per pass
+    PageKey _dedup_cursor;           // key of the next entry the scanner looks at
+    size_t _dedup_background;        // pages scanned after every command, 0 for none
+    DedupStats _dedup;
+    ZswapPool _zswap;
+    CacheHierarchy *_cache;          // its TLB is told when a page's translation changes
+    PageKey _reclaim_cursor;         // clock hand for choosing pages to compress
+    // Radix-tree geometry, root level first. The map stays the source of truth; for each
+    // level we count the mapped pages under every table that would exist, keyed by
+    // (pid, page >> _level_shift), which gives table memory and walk lengths.
+    std::vector<int> _level_bits;
+    std::vector<int> _level_shift;
+    std::vector<std::map<PageKey, int> > _level_tables;
+    uint64_t _walks;
+    uint64_t _walk_references;
+
+    int claimFrame(int frame);
+    bool unmergeEntry(PageKey key, PageEntry& entry);
+    void invalidateTranslation(PageKey key);
+    bool swapIn(PageKey key, PageEntry& entry);
+    void updateLevelTables(PageKey key, int delta);
+    int walkReferences(PageKey key, bool mapped);
 
-    std::vector<std::string> sortedKeys();
+    void uncountWorkingSet(PageKey key, PageEntry& entry);
+    void eraseEntries(uint32_t pid, std::map<PageKey, PageEntry>::iterator it, std::map<PageKey, PageEntry>::iterator end);
 
 public:
-    PageTable(int page_size);
+    PageTable(int page_size, Accounting *accounting, NumaMemory *numa, void *memory, CacheHierarchy *cache = NULL);
     ~PageTable();
 
-    void addEntry(uint32_t pid, int page_number);
-    int getPhysicalAddress(uint32_t pid, uint32_t virtual_address);
-    void print();
+    // Callers check canMapPages first; mapping a page never fails halfway through a variable
+    bool canMapPages(uint32_t pid, uint64_t pages);
+    void addEntry(uint32_t pid, uint64_t page_number);
+    void addSharedEntry(uint32_t pid, uint64_t page_number, int frame);
+    int allocateFrame(uint32_t pid = ALL_PROCESSES);
+    int allocateFrameOnNode(int node);
+    void releaseFrame(int frame);
+    // Returns -1 if the page is not mapped
+    int64_t getPhysicalAddress(uint32_t pid, uint64_t virtual_address, bool write = false);
+    void print(uint32_t pid, size_t start, size_t count, std::ostream& out);
     int getPageSize();
-    bool lookUpTable(uint32_t pid, int page_number);
-    void deleteEntry(uint32_t pid, int page_number);
+    bool lookUpTable(uint32_t pid, uint64_t page_number);
+    void deleteEntry(uint32_t pid, uint64_t page_number);
+    void deleteRange(uint32_t pid, uint64_t first_page, uint64_t last_page);
     void deleteProcessEntry(uint32_t pid);
+    int getEntryCount(uint32_t pid);
+    int getFrameCount();
+    int migrate(uint32_t pid, int node);
+    NumaMemory* getNuma();
+    void setTracking(bool tracking, uint64_t window, uint64_t interval);
+    void scanWorkingSets(size_t max_pages);
+    int getWorkingSetSize(uint32_t pid);
+    void printHeat(uint32_t pid, std::ostream& out);
+    void printWorkingSets(std::ostream& out);
+    int dedupScan(size_t max_pages);
+    int dedupPass();
+    void setDedupBackground(size_t pages);
+    void backgroundWork();
+    int getMergedFrameCount();
+    void printDedup(std::ostream& out);
+    int reclaimFrames(int pages);
+    void setZswapLimit(size_t bytes);
+    void printZswap(std::ostream& out);
+    // Fails once any page is mapped. Each level indexes bits[i] bits of the page number.
+    bool setGeometry(const std::vector<int>& bits);
+    uint64_t getVirtualSize();
+    void printGeometry(std::ostream& out);
 };
 
 #endif // __PAGETABLE_H_
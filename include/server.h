@@ -0,0 +1,58 @@
+#ifndef __SERVER_H_
+#define __SERVER_H_
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <unordered_map>
+#include <stdint.h>
+#include "command.h"
+
+// Runs one line of a session's input; anything it prints to std::cout is the response
+typedef void (*CommandRunner)(std::string_view line, TokenList& tokens, CommandContext *ctx);
+
+typedef struct Session {
+    int fd;
+    std::string input;  // received bytes that do not make up a whole line yet
+    std::string output; // responses the client has not taken yet
+    uint32_t events;    // epoll events asked for; no EPOLLIN while the client is far behind
+    bool closing;       // sent "exit" or hung up; closed once output is written
+} Session;
+
+// Serves any number of sessions over a Unix domain socket from one epoll loop, all on the
+// same simulated machine. A session works like the prompt: each line is a command and
+// is answered with its output followed by "> ". Every line that arrives in one read runs
+// before the responses go back in a single write, so clients can pipeline commands.
+class Server {
+private:
+    std::string _path;
+    CommandContext *_ctx;
+    CommandRunner _run;
+    int _listen_fd;
+    int _epoll_fd;
+    int _signal_fd;
+    std::unordered_map<int, Session> _sessions;
+    TokenList _tokens;
+    std::stringbuf _capture; // std::cout is pointed here while a session's commands run
+
+    void closeListener();
+    void acceptSessions();
+    // These return false once they have closed the session
+    bool readSession(Session& session);
+    bool writeSession(Session& session);
+    void runLines(Session& session, bool hung_up);
+    void runLine(Session& session, std::string_view line);
+    void updateEvents(Session& session);
+    void closeSession(int fd);
+
+public:
+    Server(const std::string& path, CommandContext *ctx, CommandRunner run);
+    ~Server();
+
+    // Prints the reason and returns false if the socket cannot be set up
+    bool listen();
+    // Returns after SIGINT or SIGTERM
+    void run();
+};
+
+#endif // __SERVER_H_
@@ -0,0 +1,43 @@
+#ifndef __SHM_H_
+#define __SHM_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "mmu.h"
+#include "pagetable.h"
+
+typedef struct SharedSegment {
+    std::string name;
+    DataType type;
+    uint64_t size;               // bytes, always a whole number of pages
+    std::vector<int> frames;     // the segment holds one reference on each
+    std::set<uint32_t> attached; // pids that have the segment mapped
+} SharedSegment;
+
+// Named segments of physical frames that several processes can map. A segment keeps its
+// frames alive until the last attached process detaches or terminates, or, if it is
+// never attached, until it is destroyed.
+class SharedMemory {
+private:
+    PageTable *_page_table;
+    std::map<std::string, SharedSegment*> _segments;
+
+    void destroy(std::map<std::string, SharedSegment*>::iterator it);
+
+public:
+    SharedMemory(PageTable *page_table);
+    ~SharedMemory();
+
+    SharedSegment* create(std::string name, DataType type, uint64_t size);
+    SharedSegment* find(std::string name);
+    void detach(uint32_t pid, std::string name);
+    void detachProcess(uint32_t pid);
+    // Callers check that no process is attached
+    void destroy(std::string name);
+    void print(std::ostream& out);
+};
+
+#endif // __SHM_H_
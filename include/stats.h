@@ -0,0 +1,135 @@
+#ifndef __STATS_H_
+#define __STATS_H_
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <stdint.h>
+
+// Build with -DMEMSIM_NO_STATS (make STATS=0) to compile all instrumentation out
+
+enum StatCounter : uint8_t {
+    PageTableLookups,
+    PageTableInserts,
+    PageTableDeletes,
+    FramesInUse,
+    FreeSegmentScans,
+    FreeSpaceMerges,
+    RemoteAccesses,
+    PagesMigrated,
+    CacheMisses,
+    WorkingSetScans,
+    PagesMerged,
+    CowBreaks,
+    ZswapStores,
+    ZswapLoads,
+    PageWalkReferences,
+    NumStatCounters
+};
+
+enum StatCommand : uint8_t {
+    CmdCreate,
+    CmdAllocate,
+    CmdSet,
+    CmdFree,
+    CmdTerminate,
+    CmdPrint,
+    CmdLimit,
+    CmdGroup,
+    CmdFill,
+    CmdCopy,
+    CmdSum,
+    CmdShmCreate,
+    CmdShmAttach,
+    CmdShmDetach,
+    CmdShmDestroy,
+    CmdPolicy,
+    CmdMigrate,
+    CmdCache,
+    CmdTrack,
+    CmdDedup,
+    CmdZswap,
+    CmdGeometry,
+    CmdStats,
+    CmdUnknown,
+    NumStatCommands
+};
+
+// Latency buckets are powers of two in nanoseconds: bucket i holds [2^i, 2^(i+1))
+const int STATS_HISTOGRAM_BUCKETS = 40;
+
+typedef struct CommandStats {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t histogram[STATS_HISTOGRAM_BUCKETS];
+} CommandStats;
+
+typedef struct StatsBlock {
+    int64_t counters[NumStatCounters];
+    CommandStats commands[NumStatCommands];
+} StatsBlock;
+
+// One block per thread, so the hot path never touches shared state. Only the owning thread
+// writes it while snapshot reads it from any thread, so the fields are atomics updated with
+// relaxed loads and stores, which cost no more than plain ones.
+typedef struct LiveCommandStats {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> histogram[STATS_HISTOGRAM_BUCKETS];
+} LiveCommandStats;
+
+typedef struct LiveStatsBlock {
+    std::atomic<int64_t> counters[NumStatCounters];
+    LiveCommandStats commands[NumStatCommands];
+} LiveStatsBlock;
+
+template <typename T>
+inline void statsAdd(std::atomic<T>& field, T n)
+{
+    field.store(field.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+class StatsRegistry {
+public:
+    static LiveStatsBlock& local();
+    static void recordCommand(StatCommand command, uint64_t elapsed_ns);
+    static StatsBlock snapshot();
+    static void print(std::ostream& out);
+    static bool writeJson(const std::string& file_name);
+};
+
+const char* statCommandName(StatCommand command);
+const char* statCounterName(StatCounter counter);
+
+// Times the enclosing scope and records it against a command
+class StatsTimer {
+private:
+    StatCommand _command;
+    std::chrono::steady_clock::time_point _start;
+
+public:
+    StatsTimer(StatCommand command) : _command(command), _start(std::chrono::steady_clock::now()) {}
+    ~StatsTimer()
+    {
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - _start;
+        StatsRegistry::recordCommand(_command, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+};
+
+#ifndef MEMSIM_NO_STATS
+#define STATS_ENABLED 1
+#define STATS_ADD(counter, n) statsAdd<int64_t>(StatsRegistry::local().counters[counter], (n))
+#define STATS_TIME_COMMAND(command) StatsTimer __stats_timer(command)
+#else
+#define STATS_ENABLED 0
+#define STATS_ADD(counter, n) ((void)0)
+#define STATS_TIME_COMMAND(command) ((void)0)
+#endif
+
+#define STATS_INC(counter) STATS_ADD(counter, 1)
+#define STATS_DEC(counter) STATS_ADD(counter, -1)
+
+#endif // __STATS_H_
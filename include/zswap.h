@@ -0,0 +1,47 @@
+#ifndef __ZSWAP_H_
+#define __ZSWAP_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <utility>
+#include <stdint.h>
+
+typedef struct ZswapStats {
+    uint64_t stores;
+    uint64_t loads;
+    uint64_t rejected;        // pages that did not compress well enough
+    uint64_t pool_full;       // pages turned away because the pool was at its limit
+    uint64_t bytes_in;        // uncompressed bytes of every stored page
+    uint64_t bytes_out;       // their compressed size
+    uint64_t compress_ns;
+    uint64_t decompress_ns;
+} ZswapStats;
+
+// Pool of compressed pages keyed by (pid, page number). A page is only kept if it
+// compresses to at most three quarters of its size. A limit of 0 turns storing off, but
+// pages already in the pool can still be loaded.
+class ZswapPool {
+private:
+    int _page_size;
+    size_t _limit;
+    size_t _pool_bytes;
+    std::map<std::pair<uint32_t, uint64_t>, std::vector<uint8_t> > _pages;
+    std::vector<uint8_t> _scratch;
+    ZswapStats _stats;
+
+public:
+    ZswapPool(int page_size);
+    ~ZswapPool();
+
+    void setLimit(size_t bytes);
+    bool isEnabled();
+    bool store(uint32_t pid, uint64_t page_number, const uint8_t *page);
+    // Decompresses into page and removes the page from the pool
+    bool load(uint32_t pid, uint64_t page_number, uint8_t *page);
+    void drop(uint32_t pid, uint64_t page_number);
+    size_t getStoredPages();
+    void print(std::ostream& out);
+};
+
+#endif // __ZSWAP_H_
@@ -0,0 +1,206 @@
+#include "accounting.h"
+#include "output.h"
+#include <stdio.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+Accounting::Accounting(uint64_t system_limit)
+{
+    _system_limit = system_limit;
+    _committed = 0;
+    _frames = 0;
+}
+
+Accounting::~Accounting()
+{
+}
+
+void Accounting::addProcess(uint32_t pid)
+{
+    Account account;
+    account.committed = 0;
+    account.frames = 0;
+    account.limit = 0;
+    _accounts[pid] = account;
+}
+
+void Accounting::removeProcess(uint32_t pid)
+{
+    std::unordered_map<uint32_t, Account>::iterator it = _accounts.find(pid);
+    if (it == _accounts.end()) {
+        return;
+    }
+    Account& account = it->second;
+    _committed -= account.committed;
+    if (!account.group.empty()) {
+        AccountGroup& group = _groups[account.group];
+        group.committed -= account.committed;
+        group.frames -= account.frames;
+        group.members--;
+    }
+    _accounts.erase(it);
+}
+
+// Starts out as the size of physical memory; raising it overcommits
+void Accounting::setSystemLimit(uint64_t limit)
+{
+    _system_limit = limit;
+}
+
+AccountingStatus Accounting::check(uint32_t pid, uint64_t bytes)
+{
+    if (_system_limit != 0 && _committed + bytes > _system_limit) {
+        return AccountExceedsSystem;
+    }
+    Account& account = _accounts[pid];
+    if (account.limit != 0 && account.committed + bytes > account.limit) {
+        return AccountExceedsProcess;
+    }
+    if (!account.group.empty()) {
+        AccountGroup& group = _groups[account.group];
+        if (group.limit != 0 && group.committed + bytes > group.limit) {
+            return AccountExceedsGroup;
+        }
+    }
+    return AccountOk;
+}
+
+AccountingStatus Accounting::charge(uint32_t pid, uint64_t bytes)
+{
+    AccountingStatus status = check(pid, bytes);
+    if (status != AccountOk) {
+        return status;
+    }
+    Account& account = _accounts[pid];
+    account.committed += bytes;
+    _committed += bytes;
+    if (!account.group.empty()) {
+        _groups[account.group].committed += bytes;
+    }
+    return AccountOk;
+}
+
+void Accounting::uncharge(uint32_t pid, uint64_t bytes)
+{
+    Account& account = _accounts[pid];
+    account.committed -= bytes;
+    _committed -= bytes;
+    if (!account.group.empty()) {
+        _groups[account.group].committed -= bytes;
+    }
+}
+
+void Accounting::chargeFrames(uint32_t pid, int frames)
+{
+    Account& account = _accounts[pid];
+    account.frames += frames;
+    if (!account.group.empty()) {
+        _groups[account.group].frames += frames;
+    }
+}
+
+// Called as frames leave and rejoin the free pool
+void Accounting::claimFrames(int frames)
+{
+    _frames += frames;
+}
+
+bool Accounting::setProcessLimit(uint32_t pid, uint64_t limit)
+{
+    if (_accounts.count(pid) == 0) {
+        return false;
+    }
+    _accounts[pid].limit = limit;
+    return true;
+}
+
+void Accounting::setGroupLimit(std::string group, uint64_t limit)
+{
+    if (_groups.count(group) == 0) {
+        AccountGroup created;
+        created.committed = 0;
+        created.frames = 0;
+        created.members = 0;
+        _groups[group] = created;
+    }
+    _groups[group].limit = limit;
+}
+
+bool Accounting::joinGroup(uint32_t pid, std::string group)
+{
+    if (_accounts.count(pid) == 0) {
+        return false;
+    }
+    if (_groups.count(group) == 0) {
+        setGroupLimit(group, 0);
+    }
+    // Move what the process already holds from its old group to the new one
+    Account& account = _accounts[pid];
+    if (!account.group.empty()) {
+        AccountGroup& old_group = _groups[account.group];
+        old_group.committed -= account.committed;
+        old_group.frames -= account.frames;
+        old_group.members--;
+    }
+    AccountGroup& new_group = _groups[group];
+    new_group.committed += account.committed;
+    new_group.frames += account.frames;
+    new_group.members++;
+    account.group = group;
+    return true;
+}
+
+std::string Accounting::statusMessage(AccountingStatus status, uint32_t pid)
+{
+    if (status == AccountExceedsSystem) {
+        return "this allocation would exceed system memory";
+    } else if (status == AccountExceedsProcess) {
+        return "this allocation would exceed the memory limit of process " + std::to_string(pid);
+    } else if (status == AccountExceedsGroup) {
+        return "this allocation would exceed the memory limit of group " + _accounts[pid].group;
+    }
+    return "";
+}
+
+uint64_t Accounting::getCommitted()
+{
+    return _committed;
+}
+
+int64_t Accounting::getFrames()
+{
+    return _frames;
+}
+
+void Accounting::print(std::ostream& out)
+{
+    out << " Account     | Committed  | Frames     | Limit" << std::endl;
+    out << "-------------+------------+------------+------------" << std::endl;
+    streamPrintf(out, " %-11s | %10llu | %10lld | %10llu \n", "system", (unsigned long long)_committed,
+           (long long)_frames, (unsigned long long)_system_limit);
+
+    std::map<std::string, AccountGroup> groups(_groups.begin(), _groups.end());
+    std::map<std::string, AccountGroup>::iterator git;
+    for (git = groups.begin(); git != groups.end(); git++) {
+        std::string name = "group " + git->first;
+        streamPrintf(out, " %-11s | %10llu | %10lld | %10llu \n", name.c_str(), (unsigned long long)git->second.committed,
+               (long long)git->second.frames, (unsigned long long)git->second.limit);
+    }
+
+    std::vector<uint32_t> pids;
+    std::unordered_map<uint32_t, Account>::iterator pit;
+    for (pit = _accounts.begin(); pit != _accounts.end(); pit++) {
+        pids.push_back(pit->first);
+    }
+    std::sort(pids.begin(), pids.end());
+    for (int i = 0; i < pids.size(); i++) {
+        Account& account = _accounts[pids[i]];
+        std::string name = std::to_string(pids[i]);
+        if (!account.group.empty()) {
+            name += " (" + account.group + ")";
+        }
+        streamPrintf(out, " %-11s | %10llu | %10lld | %10llu \n", name.c_str(), (unsigned long long)account.committed,
+               (long long)account.frames, (unsigned long long)account.limit);
+    }
+}
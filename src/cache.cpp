@@ -0,0 +1,294 @@
+#include "cache.h"
+#include "stats.h"
+#include <stdio.h>
+#include <algorithm>
+
+static const char *level_names[NumCacheLevels] = {"tlb", "l1", "l2", "llc"};
+static const char *replacement_names[] = {"lru", "fifo", "random"};
+
+CacheLevel::CacheLevel(uint64_t size, uint32_t ways, uint32_t line_size, uint32_t latency, CacheReplacement replacement)
+{
+    this->size = size;
+    this->line_size = line_size;
+    this->latency = latency;
+    hits = 0;
+    misses = 0;
+    _ways = ways;
+    _sets = size / line_size / ways;
+    _replacement = replacement;
+    _lines.resize((size_t)_sets * _ways, CacheLine{0, 0, 0, false});
+    _clock = 0;
+    _random_state = 0x9e3779b97f4a7c15ULL;
+}
+
+bool CacheLevel::lookup(uint64_t key, uint32_t pid)
+{
+    CacheLine *set = &_lines[(size_t)(key % _sets) * _ways];
+    _clock++;
+    CacheLine *victim = NULL;
+    for (uint32_t i = 0; i < _ways; i++) {
+        if (set[i].valid && set[i].key == key && set[i].pid == pid) {
+            if (_replacement == ReplaceLru) {
+                set[i].stamp = _clock;
+            }
+            hits++;
+            return true;
+        }
+        if (victim == NULL && !set[i].valid) {
+            victim = &set[i];
+        }
+    }
+
+    misses++;
+    if (victim == NULL) {
+        if (_replacement == ReplaceRandom) {
+            // xorshift64
+            _random_state ^= _random_state << 13;
+            _random_state ^= _random_state >> 7;
+            _random_state ^= _random_state << 17;
+            victim = &set[_random_state % _ways];
+        } else {
+            // Both LRU and FIFO evict the oldest stamp; only LRU refreshes it on a hit
+            victim = std::min_element(set, set + _ways, [](const CacheLine& a, const CacheLine& b) {
+                return a.stamp < b.stamp;
+            });
+        }
+    }
+    victim->key = key;
+    victim->pid = pid;
+    victim->stamp = _clock;
+    victim->valid = true;
+    return false;
+}
+
+void CacheLevel::invalidate(uint64_t key, uint32_t pid)
+{
+    CacheLine *set = &_lines[(size_t)(key % _sets) * _ways];
+    for (uint32_t i = 0; i < _ways; i++) {
+        if (set[i].valid && set[i].key == key && set[i].pid == pid) {
+            set[i].valid = false;
+        }
+    }
+}
+
+uint32_t CacheLevel::getWays()
+{
+    return _ways;
+}
+
+CacheReplacement CacheLevel::getReplacement()
+{
+    return _replacement;
+}
+
+CacheHierarchy::CacheHierarchy(int page_size)
+{
+    _page_size = page_size;
+    for (int i = 0; i < NumCacheLevels; i++) {
+        _levels[i] = NULL;
+    }
+    _walk_cost = 0;
+    _accesses = 0;
+    _cycles = 0;
+}
+
+CacheHierarchy::~CacheHierarchy()
+{
+    disable();
+}
+
+void CacheHierarchy::resetCounters()
+{
+    for (int i = 0; i < NumCacheLevels; i++) {
+        if (_levels[i] != NULL) {
+            CacheLevel *old = _levels[i];
+            _levels[i] = new CacheLevel(old->size, old->getWays(), old->line_size, old->latency, old->getReplacement());
+            delete old;
+        }
+    }
+    _accesses = 0;
+    _cycles = 0;
+    _processes.clear();
+}
+
+void CacheHierarchy::setLevel(CacheLevelId level, CacheLevel *cache)
+{
+    delete _levels[level];
+    _levels[level] = cache;
+    resetCounters();
+}
+
+void CacheHierarchy::setWalkCost(uint32_t walk_cost)
+{
+    _walk_cost = walk_cost;
+}
+
+void CacheHierarchy::disable()
+{
+    for (int i = 0; i < NumCacheLevels; i++) {
+        delete _levels[i];
+        _levels[i] = NULL;
+    }
+    resetCounters();
+}
+
+bool CacheHierarchy::isEnabled()
+{
+    for (int i = 0; i < NumCacheLevels; i++) {
+        if (_levels[i] != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CacheHierarchy::access(uint32_t pid, uint64_t virtual_address, uint64_t physical_address, size_t bytes, uint32_t memory_cost)
+{
+    CacheProcessStats& proc = _processes[pid];
+    uint64_t cycles = 0;
+
+    // One translation per run, since a run never crosses a page
+    CacheLevel *tlb = _levels[LevelTlb];
+    if (tlb != NULL) {
+        cycles += tlb->latency;
+        if (tlb->lookup(virtual_address / _page_size, pid)) {
+            proc.hits[LevelTlb]++;
+        } else {
+            proc.misses[LevelTlb]++;
+            cycles += _walk_cost;
+        }
+    }
+
+    // Walk the run in lines of the first cache level
+    uint32_t granule = 64;
+    for (int i = LevelL1; i < NumCacheLevels; i++) {
+        if (_levels[i] != NULL) {
+            granule = _levels[i]->line_size;
+            break;
+        }
+    }
+    uint64_t first = physical_address / granule;
+    uint64_t last = (physical_address + bytes - 1) / granule;
+    for (uint64_t line = first; line <= last; line++) {
+        cycles += accessLines(LevelL1, line * granule, granule, memory_cost, proc);
+    }
+
+    uint64_t accesses = last - first + 1;
+    proc.accesses += accesses;
+    proc.cycles += cycles;
+    _accesses += accesses;
+    _cycles += cycles;
+}
+
+// Looks up every line of the level that [address, address + bytes) touches, and fetches
+// each line that misses from the next configured level, or from memory. Returns the cycles.
+uint64_t CacheHierarchy::accessLines(int level, uint64_t address, uint64_t bytes, uint32_t memory_cost, CacheProcessStats& proc)
+{
+    while (level < NumCacheLevels && _levels[level] == NULL) {
+        level++;
+    }
+    if (level == NumCacheLevels) {
+        return memory_cost;
+    }
+    CacheLevel *cache = _levels[level];
+    uint64_t cycles = 0;
+    uint64_t first = address / cache->line_size;
+    uint64_t last = (address + bytes - 1) / cache->line_size;
+    for (uint64_t line = first; line <= last; line++) {
+        cycles += cache->latency;
+        if (cache->lookup(line)) {
+            proc.hits[level]++;
+        } else {
+            proc.misses[level]++;
+            STATS_INC(CacheMisses);
+            cycles += accessLines(level + 1, line * cache->line_size, cache->line_size, memory_cost, proc);
+        }
+    }
+    return cycles;
+}
+
+void CacheHierarchy::invalidate(uint32_t pid, uint64_t page_number)
+{
+    if (_levels[LevelTlb] != NULL) {
+        _levels[LevelTlb]->invalidate(page_number, pid);
+    }
+}
+
+static void printRate(std::string& out, uint64_t hits, uint64_t misses)
+{
+    char cell[32];
+    if (hits + misses == 0) {
+        snprintf(cell, sizeof(cell), " | %8s", "-");
+    } else {
+        snprintf(cell, sizeof(cell), " | %7.2f%%", 100.0 * hits / (hits + misses));
+    }
+    out += cell;
+}
+
+void CacheHierarchy::print(std::ostream& out)
+{
+    std::string buffer;
+    char line[160];
+    buffer += " Level | Size       | Ways | Line | Latency | Policy | Hits         | Misses       | Hit Rate\n";
+    buffer += "-------+------------+------+------+---------+--------+--------------+--------------+----------\n";
+    for (int i = 0; i < NumCacheLevels; i++) {
+        CacheLevel *level = _levels[i];
+        if (level == NULL) {
+            continue;
+        }
+        // For the TLB, size and line are in entries
+        int len = snprintf(line, sizeof(line), " %-5s | %10llu | %4u | %4u | %7u | %-6s | %12llu | %12llu",
+                           level_names[i], (unsigned long long)level->size, level->getWays(), level->line_size,
+                           level->latency, replacement_names[level->getReplacement()],
+                           (unsigned long long)level->hits, (unsigned long long)level->misses);
+        buffer.append(line, len);
+        printRate(buffer, level->hits, level->misses);
+        buffer += "\n";
+    }
+    int len = snprintf(line, sizeof(line), " Line accesses: %llu, average memory access time: %.2f cycles\n\n",
+                       (unsigned long long)_accesses, _accesses == 0 ? 0.0 : (double)_cycles / _accesses);
+    buffer.append(line, len);
+
+    buffer += " PID  | TLB      | L1       | L2       | LLC      | Accesses     | AMAT\n";
+    buffer += "------+----------+----------+----------+----------+--------------+----------\n";
+    std::vector<uint32_t> pids;
+    std::unordered_map<uint32_t, CacheProcessStats>::iterator it;
+    for (it = _processes.begin(); it != _processes.end(); it++) {
+        pids.push_back(it->first);
+    }
+    std::sort(pids.begin(), pids.end());
+    for (int i = 0; i < pids.size(); i++) {
+        CacheProcessStats& proc = _processes[pids[i]];
+        len = snprintf(line, sizeof(line), " %4u", pids[i]);
+        buffer.append(line, len);
+        for (int l = 0; l < NumCacheLevels; l++) {
+            printRate(buffer, proc.hits[l], proc.misses[l]);
+        }
+        len = snprintf(line, sizeof(line), " | %12llu | %8.2f\n", (unsigned long long)proc.accesses,
+                       proc.accesses == 0 ? 0.0 : (double)proc.cycles / proc.accesses);
+        buffer.append(line, len);
+    }
+    out << buffer;
+}
+
+bool cacheLevelFromName(std::string_view name, CacheLevelId& level)
+{
+    for (int i = 0; i < NumCacheLevels; i++) {
+        if (name == level_names[i]) {
+            level = (CacheLevelId)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool cacheReplacementFromName(std::string_view name, CacheReplacement& replacement)
+{
+    for (int i = 0; i < sizeof(replacement_names) / sizeof(replacement_names[0]); i++) {
+        if (name == replacement_names[i]) {
+            replacement = (CacheReplacement)i;
+            return true;
+        }
+    }
+    return false;
+}
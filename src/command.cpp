@@ -0,0 +1,46 @@
+#include "command.h"
+
+void tokenize(std::string_view line, TokenList& tokens)
+{
+    tokens.clear();
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == '\r')) {
+            pos++;
+        }
+        size_t start = pos;
+        while (pos < line.size() && line[pos] != ' ' && line[pos] != '\t' && line[pos] != '\r') {
+            pos++;
+        }
+        if (pos > start) {
+            tokens.push_back(line.substr(start, pos - start));
+        }
+    }
+}
+
+const CommandSpec* findCommand(const CommandSpec *table, size_t table_size, std::string_view name)
+{
+    for (size_t i = 0; i < table_size; i++) {
+        if (name == table[i].name) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+bool dataTypeFromName(std::string_view name, DataType& type)
+{
+    static const struct {
+        const char *name;
+        DataType type;
+    } types[] = {
+        {"char", Char}, {"short", Short}, {"int", Int}, {"float", Float}, {"long", Long}, {"double", Double}
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (name == types[i].name) {
+            type = types[i].type;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,151 @@
+#include "lz.h"
+#include <string.h>
+
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_MAX_OFFSET = 65535;
+static const int LZ_HASH_BITS = 12;
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash4(const uint8_t *p)
+{
+    return (read32(p) * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Writes the extra bytes of a length whose nibble saturated at 15
+static bool writeLength(uint8_t *&out, uint8_t *end, size_t length)
+{
+    for (length -= 15; ; length -= 255) {
+        if (out >= end) {
+            return false;
+        }
+        if (length < 255) {
+            *out++ = (uint8_t)length;
+            return true;
+        }
+        *out++ = 255;
+    }
+}
+
+static bool writeSequence(uint8_t *&out, uint8_t *end, const uint8_t *literals, size_t literal_count,
+                          size_t offset, size_t match_length)
+{
+    if (out >= end) {
+        return false;
+    }
+    uint8_t *token = out++;
+    *token = (uint8_t)((literal_count < 15 ? literal_count : 15) << 4);
+    if (literal_count >= 15 && !writeLength(out, end, literal_count)) {
+        return false;
+    }
+    if ((size_t)(end - out) < literal_count) {
+        return false;
+    }
+    memcpy(out, literals, literal_count);
+    out += literal_count;
+    if (match_length == 0) { // last sequence
+        return true;
+    }
+    if (end - out < 2) {
+        return false;
+    }
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+    size_t extra = match_length - LZ_MIN_MATCH;
+    *token |= (uint8_t)(extra < 15 ? extra : 15);
+    return extra < 15 || writeLength(out, end, extra);
+}
+
+size_t lzCompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity)
+{
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0xff, sizeof(table));
+
+    uint8_t *out = dst;
+    uint8_t *end = dst + dst_capacity;
+    size_t anchor = 0; // first literal not yet written
+    size_t pos = 0;
+    while (pos + LZ_MIN_MATCH <= src_size) {
+        uint32_t h = hash4(src + pos);
+        uint32_t candidate = table[h];
+        table[h] = (uint32_t)pos;
+        if (candidate == UINT32_MAX || pos - candidate > LZ_MAX_OFFSET || read32(src + candidate) != read32(src + pos)) {
+            pos++;
+            continue;
+        }
+        size_t length = LZ_MIN_MATCH;
+        while (pos + length < src_size && src[candidate + length] == src[pos + length]) {
+            length++;
+        }
+        if (!writeSequence(out, end, src + anchor, pos - anchor, pos - candidate, length)) {
+            return 0;
+        }
+        pos += length;
+        anchor = pos;
+    }
+    if (!writeSequence(out, end, src + anchor, src_size - anchor, 0, 0)) {
+        return 0;
+    }
+    return out - dst;
+}
+
+static bool readLength(const uint8_t *&in, const uint8_t *end, size_t& length)
+{
+    uint8_t byte;
+    do {
+        if (in >= end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool lzDecompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *in = src;
+    const uint8_t *in_end = src + src_size;
+    size_t written = 0;
+    while (in < in_end) {
+        uint8_t token = *in++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !readLength(in, in_end, literal_count)) {
+            return false;
+        }
+        if ((size_t)(in_end - in) < literal_count || dst_size - written < literal_count) {
+            return false;
+        }
+        memcpy(dst + written, in, literal_count);
+        in += literal_count;
+        written += literal_count;
+        if (in == in_end) { // last sequence
+            break;
+        }
+
+        if (in_end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(in, in_end, length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > written || dst_size - written < length) {
+            return false;
+        }
+        // Byte by byte, since a match may overlap the bytes it produces
+        for (size_t i = 0; i < length; i++) {
+            dst[written + i] = dst[written - offset + i];
+        }
+        written += length;
+    }
+    return written == dst_size;
+}
@@ -6,15 +6,69 @@
 #include <stdio.h>
 #include "mmu.h"
 #include "pagetable.h"
-
-std::vector<uint32_t> processesRunningSoFar;
+#include "stats.h"
+#include "command.h"
+#include "memaccess.h"
+#include "shm.h"
+#include "numa.h"
+#include "output.h"
+#include "server.h"
+#include "memsim.h"
 
 void printStartMessage(int page_size);
-void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table);
-void allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table);
-void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory);
-void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table);
-void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table);
+void runCommand(std::string_view line, TokenList& tokens, CommandContext *ctx);
+SimStatus addNumaNode(Simulator *sim, std::string_view spec);
+void printVariable(uint32_t pid, Variable *var, Simulator *sim);
+
+void handleCreate(const TokenList& args, CommandContext *ctx);
+void handleAllocate(const TokenList& args, CommandContext *ctx);
+void handleSet(const TokenList& args, CommandContext *ctx);
+void handleFree(const TokenList& args, CommandContext *ctx);
+void handleTerminate(const TokenList& args, CommandContext *ctx);
+void handlePrint(const TokenList& args, CommandContext *ctx);
+void handleLimit(const TokenList& args, CommandContext *ctx);
+void handleGroup(const TokenList& args, CommandContext *ctx);
+void handleFill(const TokenList& args, CommandContext *ctx);
+void handleCopy(const TokenList& args, CommandContext *ctx);
+void handleSum(const TokenList& args, CommandContext *ctx);
+void handleShmCreate(const TokenList& args, CommandContext *ctx);
+void handleShmAttach(const TokenList& args, CommandContext *ctx);
+void handleShmDetach(const TokenList& args, CommandContext *ctx);
+void handleShmDestroy(const TokenList& args, CommandContext *ctx);
+void handlePolicy(const TokenList& args, CommandContext *ctx);
+void handleMigrate(const TokenList& args, CommandContext *ctx);
+void handleCache(const TokenList& args, CommandContext *ctx);
+void handleTrack(const TokenList& args, CommandContext *ctx);
+void handleDedup(const TokenList& args, CommandContext *ctx);
+void handleZswap(const TokenList& args, CommandContext *ctx);
+void handleGeometry(const TokenList& args, CommandContext *ctx);
+void handleStats(const TokenList& args, CommandContext *ctx);
+
+static const CommandSpec commands[] = {
+    {"create",    CmdCreate,    3, "create <text_size> <data_size>",                            handleCreate},
+    {"allocate",  CmdAllocate,  5, "allocate <PID> <var_name> <data_type> <number_of_elements>", handleAllocate},
+    {"set",       CmdSet,       5, "set <PID> <var_name> <offset> <value_0> ... <value_N>",     handleSet},
+    {"free",      CmdFree,      3, "free <PID> <var_name>",                                     handleFree},
+    {"terminate", CmdTerminate, 2, "terminate <PID>",                                           handleTerminate},
+    {"print",     CmdPrint,     2, "print <object>",                                            handlePrint},
+    {"limit",     CmdLimit,     3, "limit <PID> <bytes>, limit group <name> <bytes> or limit system <bytes>", handleLimit},
+    {"group",     CmdGroup,     3, "group <PID> <name>",                                        handleGroup},
+    {"fill",      CmdFill,      6, "fill <PID> <var_name> <offset> <count> <value>",            handleFill},
+    {"copy",      CmdCopy,      3, "copy <PID>:<src_var> <PID>:<dst_var>",                      handleCopy},
+    {"sum",       CmdSum,       2, "sum <PID>:<var_name>",                                      handleSum},
+    {"shmcreate", CmdShmCreate, 3, "shmcreate <name> <size> [<data_type>]",                    handleShmCreate},
+    {"shmattach", CmdShmAttach, 3, "shmattach <PID> <name>",                                    handleShmAttach},
+    {"shmdetach", CmdShmDetach, 3, "shmdetach <PID> <name>",                                    handleShmDetach},
+    {"shmdestroy", CmdShmDestroy, 2, "shmdestroy <name>",                                       handleShmDestroy},
+    {"policy",    CmdPolicy,    3, "policy <PID> local [<node>] | interleave | bind <node>",    handlePolicy},
+    {"migrate",   CmdMigrate,   3, "migrate <PID> <node>",                                      handleMigrate},
+    {"cache",     CmdCache,     2, "cache <level> <size> <ways> <line_size> <latency> [<policy>] or cache tlb <entries> <ways> <latency> <walk_cost> [<policy>] or cache off", handleCache},
+    {"track",     CmdTrack,     2, "track on|off [<window> [<scan_interval>]]",                 handleTrack},
+    {"dedup",     CmdDedup,     1, "dedup [auto <pages> | off]",                                 handleDedup},
+    {"zswap",     CmdZswap,     2, "zswap <pool_bytes> | off",                                  handleZswap},
+    {"geometry",  CmdGeometry,  2, "geometry <bits_0> ... <bits_N>",                            handleGeometry},
+    {"stats",     CmdStats,     1, "stats [json <file>]",                                       handleStats}
+};
 
 int main(int argc, char **argv)
 {
@@ -25,496 +79,654 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // Print opening instuction message
+    // Physical memory is made of the nodes given after the page size, or one 64 MB node.
+    // --serve <socket_path> takes sessions over a Unix domain socket instead of stdin.
     int page_size = std::stoi(argv[1]);
-    printStartMessage(page_size);
-
-    // Create physical 'memory'
-    uint32_t mem_size = 67108864; // Bytes
-    void *memory = malloc(mem_size); // 64 MB (64 * 1024 * 1024)
-    memset(memory,'\0',sizeof(memory));
-    
-    // Create MMU and Page Table
-    Mmu *mmu = new Mmu(mem_size);
-    PageTable *page_table = new PageTable(page_size);
-
-    // Prompt loop
-    std::string command;
-    std::cout << "> ";
-    std::getline (std::cin, command);
-    while (command != "exit") {
-        std::vector<std::string> command_list;
-        std::string del = " ";
-        size_t pos = 0;
-        std::string token;
-        while ((pos = command.find(del)) != std::string::npos) {
-            token = command.substr(0, pos);
-            command_list.push_back(token);
-            command.erase(0, pos + del.length());
+    const char *socket_path = NULL;
+    Simulator *sim = new Simulator(page_size);
+    SimStatus sim_status = SimOk;
+    for (int i = 2; i < argc && sim_status == SimOk; i++) {
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if ((sim_status = addNumaNode(sim, argv[i])) == SimInvalidNode) {
+            fprintf(stderr, "Error: invalid node '%s', expected <bytes>[:<local_cost>[:<remote_cost>]]\n", argv[i]);
+            return 1;
         }
-        command_list.push_back(command); // Get commands split by space
-        // Handle command
-        if (command_list[0] == "create") {
-            int text_size = std::stoi(command_list[1]);
-            int data_size = std::stoi(command_list[2]);
-            createProcess(text_size, data_size, mmu, page_table);
-        } else if (command_list[0] == "allocate") {
-            uint32_t pid = static_cast<uint32_t>(std::stoul(command_list[1]));
-            std::string var_name = command_list[2];
-            std::string typeInString = command_list[3];
-            DataType type;
-            if (typeInString == "char") {
-                type = Char;
-            } else if (typeInString == "short") {
-                type = Short;
-            } else if (typeInString == "int") {
-                type = Int;
-            } else if (typeInString == "float") {
-                type = Float;
-            } else if (typeInString == "long") {
-                type = Long;
-            } else if (typeInString == "double") {
-                type = Double;
-            }
-            uint32_t num_elements = static_cast<uint32_t>(std::stoul(command_list[4]));
-            if (!mmu->doWeHaveProcess(pid)) {
-                // error: process not found
-                std::cout << "error: process not found" << std::endl;
-            } else if (mmu->doWeHaveVariable(pid, var_name)) {
-                // error: variable already exists
-                std::cout << "error: variable already exists" << std::endl;
-            } else {
-                allocateVariable(pid, var_name, type, num_elements, mmu, page_table);
-            }
-        } else if (command_list[0] == "set") {
-            uint32_t pid = static_cast<uint32_t>(std::stoul(command_list[1]));
-            std::string var_name = command_list[2];
-            uint32_t offset = static_cast<uint32_t>(std::stoul(command_list[3]));
-            if (!mmu->doWeHaveProcess(pid)) {
-                // error: process not found
-                std::cout << "error: process not found" << std::endl;
-            } else if (!mmu->doWeHaveVariable(pid, var_name)) {
-                // error: variable not found
-                std::cout << "error: variable not found" << std::endl;
-            } else {
-                if (mmu->getVariableType(pid, var_name) == DataType::Char) {
-                    for (int i = 4; i < command_list.size(); i++) {
-                        char value = command_list[i][0];
-                        setVariable(pid, var_name, offset, &value, mmu, page_table, memory);
-                        offset++;
-                    }
-                } else if (mmu->getVariableType(pid, var_name) == DataType::Short) {
-                    for (int i = 4; i < command_list.size(); i++) {
-                        int temp = stoi(command_list[i]);
-                        short value = (short)temp;
-                        setVariable(pid, var_name, offset, &value, mmu, page_table, memory);
-                        offset++;
-                    }
-                } else if (mmu->getVariableType(pid, var_name) == DataType::Int) {
-                    for (int i = 4; i < command_list.size(); i++) {
-                        int value = stoi(command_list[i]);
-                        setVariable(pid, var_name, offset, &value, mmu, page_table, memory);
-                        offset++;
-                    }
-                } else if (mmu->getVariableType(pid, var_name) == DataType::Float) {
-                    for (int i = 4; i < command_list.size(); i++) {
-                        float value = stof(command_list[i]);
-                        setVariable(pid, var_name, offset, &value, mmu, page_table, memory);
-                        offset++;
-                    }
-                } else if (mmu->getVariableType(pid, var_name) == DataType::Long) {
-                    for (int i = 4; i < command_list.size(); i++) {
-                        long value = stol(command_list[i]);
-                        setVariable(pid, var_name, offset, &value, mmu, page_table, memory);
-                        offset++;
-                    }
-                } else if (mmu->getVariableType(pid, var_name) == DataType::Double) {
-                    for (int i = 4; i < command_list.size(); i++) {
-                        double value = stod(command_list[i]);
-                        setVariable(pid, var_name, offset, &value, mmu, page_table, memory);
-                        offset++;
-                    }
-                }
-            }
-        } else if (command_list[0] == "free") {
-            uint32_t pid = static_cast<uint32_t>(std::stoul(command_list[1]));
-            std::string var_name = command_list[2];
-            if (!mmu->doWeHaveProcess(pid)) {
-                // error: process not found
-                std::cout << "error: process not found" << std::endl;
-            } else if (!mmu->doWeHaveVariable(pid, var_name)) {
-                // error: variable not found
-                std::cout << "error: variable not found" << std::endl;
-            } else {
-                freeVariable(pid, var_name, mmu, page_table);
-            }
-        } else if (command_list[0] == "terminate") {
-            uint32_t pid = static_cast<uint32_t>(std::stoul(command_list[1]));
-            if (!mmu->doWeHaveProcess(pid)) {
-                // error: process not found
-                std::cout << "error: process not found" << std::endl;
-            } else {
-                terminateProcess(pid, mmu, page_table);
-            }
-        } else if (command_list[0] == "print") {
-            if (command_list[1] == "mmu") {
-                mmu->print();
-            } else if (command_list[1] == "page") {
-                page_table->print();
-            } else if (command_list[1] == "processes") {
-                mmu->printProcesses();
-            } else {
-                std::vector<std::string> pidAndVar;
-                std::string del2 = ":";
-                size_t pos2 = 0;
-                std::string token2;
-                while ((pos2 = command_list[1].find(del2)) != std::string::npos) {
-                    token2 = command_list[1].substr(0, pos2);
-                    pidAndVar.push_back(token2);
-                    command_list[1].erase(0, pos2 + del2.length());
-                }
-                pidAndVar.push_back(command_list[1]);
-                uint32_t tempPid = static_cast<uint32_t>(std::stoul(pidAndVar[0]));
-                Variable* tempVar = mmu->findVariable(tempPid, pidAndVar[1]);
-                //int phys_addr = page_table->getPhysicalAddress(tempPid, tempVar->virtual_address);
-                if (tempVar->type == DataType::Char) {
-                    uint32_t items = tempVar->size / 1;
-                    char tempCharArray[items];
-                    for (int d = 0; d < items; d++) {
-                        memcpy(tempCharArray + d, (char*)memory + page_table->getPhysicalAddress(tempPid, tempVar->virtual_address + d * 1), 1);
-                    }
-                    if (items > 4) { // do we have more than 4 items?
-                        printf("%c", tempCharArray[0]);
-                        for (int h = 1; h < 4; h++) { // print first 4 items
-                            printf(", %c", tempCharArray[h]);
-                        }
-                        printf(", ... [%d items]\n", items);
-                    } else {
-                        printf("%c", tempCharArray[0]);
-                        for (int h = 1; h < items; h++) { // print first 4 items
-                            printf(", %c", tempCharArray[h]);
-                        }
-                        printf("\n");
-                    }
-                } else if (tempVar->type == DataType::Short) {
-                    uint32_t items = tempVar->size / 2;
-                    short tempCharArray[items];
-                    for (int d = 0; d < items; d++) {
-                        memcpy(tempCharArray + d, (char*)memory + page_table->getPhysicalAddress(tempPid, tempVar->virtual_address + d * 2), 2);
-                    }
-                    if (items > 4) { // do we have more than 4 items?
-                        printf("%hd", tempCharArray[0]);
-                        for (int h = 1; h < 4; h++) { // print first 4 items
-                            printf(", %hd", tempCharArray[h]);
-                        }
-                        printf(", ... [%d items]\n", items);
-                    } else {
-                        printf("%hd", tempCharArray[0]);
-                        for (int h = 1; h < items; h++) { // print first 4 items
-                            printf(", %hd", tempCharArray[h]);
-                        }
-                        printf("\n");
-                    }
-                } else if (tempVar->type == DataType::Int) {
-                    uint32_t items = tempVar->size / 4;
-                    int tempCharArray[items];
-                    for (int d = 0; d < items; d++) {
-                        memcpy(tempCharArray + d, (char*)memory + page_table->getPhysicalAddress(tempPid, tempVar->virtual_address + d * 4), 4);
-                    }
-                    if (items > 4) { // do we have more than 4 items?
-                        printf("%d", tempCharArray[0]);
-                        for (int h = 1; h < 4; h++) { // print first 4 items
-                            printf(", %d", tempCharArray[h]);
-                        }
-                        printf(", ... [%d items]\n", items);
-                    } else {
-                        printf("%d", tempCharArray[0]);
-                        for (int h = 1; h < items; h++) { // print first 4 items
-                            printf(", %d", tempCharArray[h]);
-                        }
-                        printf("\n");
-                    }
-                } else if (tempVar->type == DataType::Float) {
-                    uint32_t items = tempVar->size / 4;
-                    float tempCharArray[items];
-                    for (int d = 0; d < items; d++) {
-                        memcpy(tempCharArray + d, (char*)memory + page_table->getPhysicalAddress(tempPid, tempVar->virtual_address + d * 4), 4);
-                    }
-                    if (items > 4) { // do we have more than 4 items?
-                        printf("%f", tempCharArray[0]);
-                        for (int h = 1; h < 4; h++) { // print first 4 items
-                            printf(", %f", tempCharArray[h]);
-                        }
-                        printf(", ... [%d items]\n", items);
-                    } else {
-                        printf("%f", tempCharArray[0]);
-                        for (int h = 1; h < items; h++) { // print first 4 items
-                            printf(", %f", tempCharArray[h]);
-                        }
-                        printf("\n");
-                    }
-                } else if (tempVar->type == DataType::Long) {
-                    uint32_t items = tempVar->size / 8;
-                    long tempCharArray[items];
-                    for (int d = 0; d < items; d++) {
-                        memcpy(tempCharArray + d, (char*)memory + page_table->getPhysicalAddress(tempPid, tempVar->virtual_address + d * 8), 8);
-                    }
-                    if (items > 4) { // do we have more than 4 items?
-                        printf("%ld", tempCharArray[0]);
-                        for (int h = 1; h < 4; h++) { // print first 4 items
-                            printf(", %ld", tempCharArray[h]);
-                        }
-                        printf(", ... [%d items]\n", items);
-                    } else {
-                        printf("%ld", tempCharArray[0]);
-                        for (int h = 1; h < items; h++) { // print first 4 items
-                            printf(", %ld", tempCharArray[h]);
-                        }
-                        printf("\n");
-                    }
-                } else if (tempVar->type == DataType::Double) {
-                    uint32_t items = tempVar->size / 8;
-                    double tempCharArray[items];
-                    for (int d = 0; d < items; d++) {
-                        memcpy(tempCharArray + d, (char*)memory + page_table->getPhysicalAddress(tempPid, tempVar->virtual_address + d * 8), 8);
-                    }
-                    if (items > 4) { // do we have more than 4 items?
-                        printf("%f", tempCharArray[0]);
-                        for (int h = 1; h < 4; h++) { // print first 4 items
-                            printf(", %f", tempCharArray[h]);
-                        }
-                        printf(", ... [%d items]\n", items);
-                    } else {
-                        printf("%f", tempCharArray[0]);
-                        for (int h = 1; h < items; h++) { // print first 4 items
-                            printf(", %f", tempCharArray[h]);
-                        }
-                        printf("\n");
-                    }
-                }
-                
-            }
+    }
+
+    // Create physical 'memory' and the machine around it
+    if (sim_status == SimOk) {
+        sim_status = sim->init();
+    }
+    if (sim_status == SimOutOfMemory) {
+        fprintf(stderr, "Error: could not allocate %llu bytes of physical memory\n", (unsigned long long)sim->getMemorySize());
+        return 1;
+    } else if (sim_status != SimOk) {
+        fprintf(stderr, "Error: %s\n", sim->statusMessage(sim_status, ALL_PROCESSES).c_str());
+        return 1;
+    }
+
+    // Print opening instuction message
+    if (socket_path == NULL) {
+        printStartMessage(page_size);
+    }
+    CommandContext ctx = {sim};
 
+    int status = 0;
+    if (socket_path != NULL) {
+        Server server(socket_path, &ctx, runCommand);
+        if (server.listen()) {
+            std::cout << "Serving sessions on " << socket_path << " with a page size of " << page_size << " bytes" << std::endl;
+            server.run();
         } else {
-            std::cout << "error: command not recognized" << std::endl;
+            status = 1;
         }
-        // Get next command
+    } else {
+        // Prompt loop. The line buffer and token list are reused, and tokens are views into the line.
+        std::string command;
+        TokenList command_list;
         std::cout << "> ";
-        std::getline (std::cin, command);
+        while (std::getline(std::cin, command) && command != "exit") {
+            runCommand(command, command_list, &ctx);
+            // Get next command
+            std::cout << "> ";
+        }
     }
 
     // Clean up
-    free(memory);
-    delete mmu;
-    delete page_table;
+    delete sim;
 
-    return 0;
+    return status;
 }
 
-void printStartMessage(int page_size)
+// Run one line of input. Tokens are views into the line.
+void runCommand(std::string_view line, TokenList& tokens, CommandContext *ctx)
 {
-    std::cout << "Welcome to the Memory Allocation Simulator! Using a page size of " << page_size << " bytes." << std:: endl;
-    std::cout << "Commands:" << std:: endl;
-    std::cout << "  * create <text_size> <data_size> (initializes a new process)" << std:: endl;
-    std::cout << "  * allocate <PID> <var_name> <data_type> <number_of_elements> (allocated memory on the heap)" << std:: endl;
-    std::cout << "  * set <PID> <var_name> <offset> <value_0> <value_1> <value_2> ... <value_N> (set the value for a variable)" << std:: endl;
-    std::cout << "  * free <PID> <var_name> (deallocate memory on the heap that is associated with <var_name>)" << std:: endl;
-    std::cout << "  * terminate <PID> (kill the specified process)" << std:: endl;
-    std::cout << "  * print <object> (prints data)" << std:: endl;
-    std::cout << "    * If <object> is \"mmu\", print the MMU memory table" << std:: endl;
-    std::cout << "    * if <object> is \"page\", print the page table" << std:: endl;
-    std::cout << "    * if <object> is \"processes\", print a list of PIDs for processes that are still running" << std:: endl;
-    std::cout << "    * if <object> is a \"<PID>:<var_name>\", print the value of the variable for that process" << std:: endl;
-    std::cout << std::endl;
+    ctx->sim->backgroundWork(); // kept out of the command's timing
+    tokenize(line, tokens);
+    if (tokens.empty()) {
+        return;
+    }
+    const CommandSpec *spec = findCommand(commands, sizeof(commands) / sizeof(commands[0]), tokens[0]);
+    STATS_TIME_COMMAND(spec != NULL ? spec->stat : CmdUnknown);
+    // Handle command
+    if (spec == NULL) {
+        std::cout << "error: command not recognized" << std::endl;
+    } else if (tokens.size() < spec->min_args) {
+        std::cout << "error: usage is " << spec->usage << std::endl;
+    } else {
+        spec->handler(tokens, ctx);
+    }
+}
+
+// Parse a numeric argument, reporting an error when it is malformed
+template <typename T>
+static bool parseArgument(std::string_view token, T& value)
+{
+    if (!parseValue(token, value)) {
+        std::cout << "error: invalid number '" << token << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Print the error for a failed operation; returns whether it succeeded
+static bool reportStatus(SimStatus status, uint32_t pid, CommandContext *ctx)
+{
+    if (status != SimOk) {
+        std::cout << "error: " << ctx->sim->statusMessage(status, pid) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void handleCreate(const TokenList& args, CommandContext *ctx)
+{
+    uint64_t text_size, data_size;
+    uint32_t pid;
+    if (!parseArgument(args[1], text_size) || !parseArgument(args[2], data_size)) {
+        return;
+    }
+    if (reportStatus(ctx->sim->createProcess(text_size, data_size, &pid), pid, ctx)) {
+        std::cout << pid << std::endl;
+    }
 }
 
-void createProcess(int text_size, int data_size, Mmu *mmu, PageTable *page_table)
+void handleAllocate(const TokenList& args, CommandContext *ctx)
 {
     uint32_t pid;
-    uint32_t stack_size = 65536;
-    std::string text = "<TEXT>";
-    std::string globals = "<GLOBALS>";
-    std::string stack = "<STACK>";
-    //   - create new process in the MMU
-    pid = mmu->createProcess();
-    //   - allocate new variables for the <TEXT>, <GLOBALS>, and <STACK>
-    allocateVariable(pid, text, DataType::Char, (uint32_t)text_size, mmu, page_table);
-    allocateVariable(pid, globals, DataType::Char, (uint32_t)data_size, mmu, page_table);
-    allocateVariable(pid, stack, DataType::Char, stack_size, mmu, page_table);
-    //   - print pid
-    std::cout << pid << std::endl;
-}
-
-void allocateVariable(uint32_t pid, std::string var_name, DataType type, uint32_t num_elements, Mmu *mmu, PageTable *page_table)
-{
-    // Get the total size of this new var
-    uint32_t sizeInTotal;
-    int sizeOfType;
-    if (DataType::Char == type) {
-        sizeInTotal = num_elements * 1;
-        sizeOfType = 1;
-    } else if (DataType::Short == type) {
-        sizeInTotal = num_elements * 2;
-        sizeOfType = 2;
-    } else if (DataType::Int == type || DataType::Float == type) {
-        sizeInTotal = num_elements * 4;
-        sizeOfType = 4;
-    } else if (DataType::Double == type || DataType::Long == type) {
-        sizeInTotal = num_elements * 8;
-        sizeOfType = 8;
-    }
-    // Get variableList
-    std::vector<Variable*> variableList = mmu->getVariableList(pid);
-
-    int idxToInsert = -1;
-    // Loop through the varList to find the middle spot that next to <free space>
-    for (int i = 0; i < variableList.size(); i++) {
-        if (variableList[i]->name == "<FREE_SPACE>") {
-            if (variableList[i]->size >= sizeInTotal) {
-                idxToInsert = i;
-                break;
+    uint64_t num_elements;
+    DataType type;
+    if (!parseArgument(args[1], pid) || !parseArgument(args[4], num_elements)) {
+        return;
+    }
+    std::string var_name(args[2]);
+    uint64_t address;
+    if (!dataTypeFromName(args[3], type)) {
+        // error: unknown data type
+        std::cout << "error: unknown data type" << std::endl;
+    } else if (reportStatus(ctx->sim->allocate(pid, var_name, type, num_elements, &address), pid, ctx)) {
+        std::cout << address << std::endl;
+    }
+}
+
+// Look up a variable for a command, printing the usual errors when it does not exist
+static Variable* lookUpVariable(uint32_t pid, const std::string& var_name, CommandContext *ctx)
+{
+    Variable *var;
+    if (!reportStatus(ctx->sim->findVariable(pid, var_name, &var), pid, ctx)) {
+        return NULL;
+    }
+    return var;
+}
+
+// Parse a "<PID>:<var_name>" token
+static bool parseVariableName(std::string_view token, uint32_t& pid, std::string& var_name)
+{
+    size_t sep = token.find(':');
+    if (sep == std::string_view::npos || !parseValue(token.substr(0, sep), pid)) {
+        std::cout << "error: expected <PID>:<var_name> but got '" << token << "'" << std::endl;
+        return false;
+    }
+    var_name = token.substr(sep + 1);
+    return true;
+}
+
+// Parse a "<PID>:<var_name>" token and look the variable up
+static Variable* lookUpVariable(std::string_view token, uint32_t& pid, CommandContext *ctx)
+{
+    std::string var_name;
+    if (!parseVariableName(token, pid, var_name)) {
+        return NULL;
+    }
+    return lookUpVariable(pid, var_name, ctx);
+}
+
+void handleSet(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    uint64_t offset;
+    if (!parseArgument(args[1], pid) || !parseArgument(args[3], offset)) {
+        return;
+    }
+    std::string var_name(args[2]);
+    Variable *var = lookUpVariable(pid, var_name, ctx);
+    if (var == NULL) {
+        return;
+    }
+    // Parse every value straight into a typed buffer, then store them with one bulk write
+    dispatchDataType(var->type, [&](auto tag) {
+        typedef decltype(tag) T;
+        static thread_local std::vector<T> values;
+        values.resize(args.size() - 4);
+        for (size_t i = 4; i < args.size(); i++) {
+            if (!parseValue(args[i], values[i - 4])) {
+                std::cout << "error: invalid value '" << args[i] << "'" << std::endl;
+                return;
             }
         }
+        reportStatus(ctx->sim->write(pid, var_name, offset, values.data(), values.size()), pid, ctx);
+    });
+}
+
+void handleFill(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    uint64_t offset, count;
+    if (!parseArgument(args[1], pid) || !parseArgument(args[3], offset) || !parseArgument(args[4], count)) {
+        return;
     }
-    
-    if (idxToInsert == -1) {
-        // no free space in that process which means it exceeds 64 MB
-        std::cout << "error!!! -1 " << std::endl;
-        // error
+    std::string var_name(args[2]);
+    Variable *var = lookUpVariable(pid, var_name, ctx);
+    if (var == NULL) {
         return;
     }
-    
-    double start_page_double;
-    double end_page_double;
-    int start_page_int;
-    int end_page_int;
-
-    // VariableList looks like: [<TEXT>, <GLOBALS>, <STACK>, thisIsAnInt, <FREE_SPACE>]
-    //                                                                   ^
-    //                                                   each time we insert the new var here
-
-    if (idxToInsert != 0) { // if the new var has a neighbor on its left
-        if (sizeInTotal > page_table->getPageSize() - (variableList[idxToInsert-1]->size + variableList[idxToInsert-1]->virtual_address) % page_table->getPageSize()) {
-            start_page_double = ((double)variableList[idxToInsert-1]->size + (double)variableList[idxToInsert-1]->virtual_address) / (double)page_table->getPageSize();
-            start_page_int = floor(start_page_double); // index, 0 ~ n
-            end_page_double = ((double)variableList[idxToInsert-1]->size + (double)variableList[idxToInsert-1]->virtual_address + (double)sizeInTotal) / (double)page_table->getPageSize();
-            end_page_int = floor(end_page_double); // index, 0 ~ n
-            int leftover = page_table->getPageSize() - ((variableList[idxToInsert-1]->size + variableList[idxToInsert-1]->virtual_address) % page_table->getPageSize());
-            
-            if (leftover % sizeOfType != 0) { // if leftover can't be divided with no remainder by type size
-                uint32_t shortSpaceSize = leftover % sizeOfType;
-                // we get a small hole in between
-                mmu->addVariableToProcess(pid, "<FREE_SPACE>", DataType::Char, shortSpaceSize, variableList[idxToInsert-1]->size + variableList[idxToInsert-1]->virtual_address, idxToInsert);
-                idxToInsert++; // go right by 1 index
-            }
-            // find rest of pages whether have been on the book
-            for (int i = start_page_int + 1; i <= end_page_int; i++) {
-                if(!page_table->lookUpTable(pid, i)) { // if false, need to create new pages
-                    page_table->addEntry(pid, i);
-                }
+    dispatchDataType(var->type, [&](auto tag) {
+        typedef decltype(tag) T;
+        T value;
+        if (!parseValue(args[5], value)) {
+            std::cout << "error: invalid value '" << args[5] << "'" << std::endl;
+            return;
+        }
+        reportStatus(ctx->sim->fill(pid, var_name, offset, count, value), pid, ctx);
+    });
+}
+
+void handleCopy(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t src_pid, dst_pid;
+    std::string src_name, dst_name;
+    if (!parseVariableName(args[1], src_pid, src_name) || !parseVariableName(args[2], dst_pid, dst_name)) {
+        return;
+    }
+    reportStatus(ctx->sim->copy(src_pid, src_name, dst_pid, dst_name), src_pid, ctx);
+}
+
+void handleSum(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    Variable *var = lookUpVariable(args[1], pid, ctx);
+    if (var == NULL) {
+        return;
+    }
+    std::string var_name = var->name;
+    dispatchDataType(var->type, [&](auto tag) {
+        typedef decltype(tag) T;
+        if constexpr (std::is_floating_point<T>::value) {
+            double total = 0;
+            if (reportStatus(ctx->sim->sum<T>(pid, var_name, total), pid, ctx)) {
+                streamPrintf(std::cout, "%f\n", total);
             }
-            std::vector<Variable*> variableList = mmu->getVariableList(pid);
-            mmu->addVariableToProcess(pid, var_name, type, sizeInTotal, variableList[idxToInsert-1]->size + variableList[idxToInsert-1]->virtual_address, idxToInsert);
-            
         } else {
-            // insert new var
-            mmu->addVariableToProcess(pid, var_name, type, sizeInTotal, variableList[idxToInsert-1]->size + variableList[idxToInsert-1]->virtual_address, idxToInsert);
-            
-        }
-    } else if (idxToInsert == 0) { // the new var is the most left one
-        // Then it must be <TEXT>
-        // It's an empty book, so just create pages for it
-
-        end_page_double = (double)sizeInTotal / (double)page_table->getPageSize();
-        start_page_int = 0;
-        end_page_int = floor(end_page_double);
-        for (int i = start_page_int + 1; i <= end_page_int; i++) { 
-            if(!page_table->lookUpTable(pid, i)) {
-                page_table->addEntry(pid, i);
-            } else {
-                std::cout << "--- We got a bug on Line 445 main ---" << std::endl;
+            long long total = 0;
+            if (reportStatus(ctx->sim->sum<T>(pid, var_name, total), pid, ctx)) {
+                streamPrintf(std::cout, "%lld\n", total);
             }
         }
-        mmu->addVariableToProcess(pid, var_name, type, sizeInTotal, 0, idxToInsert);
-    }
-
-}
-
-void setVariable(uint32_t pid, std::string var_name, uint32_t offset, void *value, Mmu *mmu, PageTable *page_table, void *memory)
-{
-    Variable* targetVar;
-    int phys_addr;
-    uint32_t idx;
-    if (DataType::Char == mmu->getVariableType(pid, var_name)) {
-        targetVar = mmu->findVariable(pid, var_name);
-        idx = targetVar->virtual_address + offset * 1;
-        phys_addr = page_table->getPhysicalAddress(pid, idx);
-        memcpy((char*)memory + phys_addr, value, 1);
-    } else if (DataType::Short == mmu->getVariableType(pid, var_name)) {
-        targetVar = mmu->findVariable(pid, var_name);
-        idx = targetVar->virtual_address + offset * 2;
-        phys_addr = page_table->getPhysicalAddress(pid, idx);
-        memcpy((char*)memory + phys_addr, value, 2);
-    } else if (DataType::Int == mmu->getVariableType(pid, var_name)) {
-        targetVar = mmu->findVariable(pid, var_name);
-        idx = targetVar->virtual_address + offset * 4;
-        phys_addr = page_table->getPhysicalAddress(pid, idx);
-        memcpy((char*)memory + phys_addr, value, 4);
-    } else if (DataType::Float == mmu->getVariableType(pid, var_name)) {
-        targetVar = mmu->findVariable(pid, var_name);
-        idx = targetVar->virtual_address + offset * 4;
-        phys_addr = page_table->getPhysicalAddress(pid, idx);
-        memcpy((char*)memory + phys_addr, value, 4);
-    } else if (DataType::Long == mmu->getVariableType(pid, var_name)) {
-        targetVar = mmu->findVariable(pid, var_name);
-        idx = targetVar->virtual_address + offset * 8;
-        phys_addr = page_table->getPhysicalAddress(pid, idx);
-        memcpy((char*)memory + phys_addr, value, 8);
-    } else if (DataType::Double == mmu->getVariableType(pid, var_name)) {
-        targetVar = mmu->findVariable(pid, var_name);
-        idx = targetVar->virtual_address + offset * 8;
-        phys_addr = page_table->getPhysicalAddress(pid, idx);
-        memcpy((char*)memory + phys_addr, value, 8);
-    }
-}
-
-void freeVariable(uint32_t pid, std::string var_name, Mmu *mmu, PageTable *page_table)
-{
-    // Get variableList
-    std::vector<Variable*> variableList = mmu->getVariableList(pid);
-    int idxToRemove = -1;
-    for (int i = 0; i < variableList.size(); i++) {
-        if (variableList[i]->name == var_name) {
-            idxToRemove = i;
-            break;
+    });
+}
+
+void handleFree(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    if (!parseArgument(args[1], pid)) {
+        return;
+    }
+    reportStatus(ctx->sim->freeVariable(pid, std::string(args[2])), pid, ctx);
+}
+
+void handleTerminate(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    if (!parseArgument(args[1], pid)) {
+        return;
+    }
+    reportStatus(ctx->sim->terminate(pid), pid, ctx);
+}
+
+void handlePrint(const TokenList& args, CommandContext *ctx)
+{
+    if (args[1] == "mmu") {
+        ctx->sim->printMmu(std::cout);
+    } else if (args[1] == "page") {
+        // print page [<PID>|all] [<start> [<count>]]; without a count every row from <start> is printed
+        uint32_t pid = ALL_PROCESSES;
+        size_t start = 0;
+        size_t count = SIZE_MAX;
+        if (args.size() > 2 && args[2] != "all" && !parseArgument(args[2], pid)) {
+            return;
+        }
+        if (args.size() > 3 && !parseArgument(args[3], start)) {
+            return;
+        }
+        if (args.size() > 4 && !parseArgument(args[4], count)) {
+            return;
+        }
+        ctx->sim->printPageTable(pid, start, count, std::cout);
+    } else if (args[1] == "processes") {
+        ctx->sim->printProcesses(std::cout);
+    } else if (args[1] == "memstat") {
+        ctx->sim->printMemStat(std::cout);
+    } else if (args[1] == "accounting") {
+        ctx->sim->printAccounting(std::cout);
+    } else if (args[1] == "shm") {
+        ctx->sim->printSharedMemory(std::cout);
+    } else if (args[1] == "heat") {
+        uint32_t pid;
+        if (args.size() < 3) {
+            std::cout << "error: usage is print heat <PID>" << std::endl;
+        } else if (parseArgument(args[2], pid)) {
+            reportStatus(ctx->sim->printHeat(pid, std::cout), pid, ctx);
+        }
+    } else if (args[1] == "zswap") {
+        ctx->sim->printZswap(std::cout);
+    } else if (args[1] == "geometry") {
+        ctx->sim->printGeometry(std::cout);
+    } else if (args[1] == "dedup") {
+        ctx->sim->printDedup(std::cout);
+    } else if (args[1] == "wss") {
+        ctx->sim->printWorkingSets(std::cout);
+    } else if (args[1] == "cache") {
+        ctx->sim->printCache(std::cout);
+    } else if (args[1] == "numa") {
+        ctx->sim->printNuma(std::cout);
+    } else {
+        // <PID>:<var_name>
+        uint32_t pid;
+        Variable *var = lookUpVariable(args[1], pid, ctx);
+        if (var != NULL) {
+            printVariable(pid, var, ctx->sim);
+        }
+    }
+}
+
+void handleLimit(const TokenList& args, CommandContext *ctx)
+{
+    uint64_t limit;
+    if (args.size() == 3 && args[1] == "system") {
+        if (parseArgument(args[2], limit)) {
+            reportStatus(ctx->sim->setSystemLimit(limit), ALL_PROCESSES, ctx);
+        }
+    } else if (args.size() == 4 && args[1] == "group") {
+        if (parseArgument(args[3], limit)) {
+            reportStatus(ctx->sim->setGroupLimit(std::string(args[2]), limit), ALL_PROCESSES, ctx);
+        }
+    } else if (args.size() == 3) {
+        uint32_t pid;
+        if (!parseArgument(args[1], pid) || !parseArgument(args[2], limit)) {
+            return;
         }
+        reportStatus(ctx->sim->setProcessLimit(pid, limit), pid, ctx);
+    } else {
+        std::cout << "error: usage is limit <PID> <bytes>, limit group <name> <bytes> or limit system <bytes>" << std::endl;
     }
-    
-    if (idxToRemove == -1) {
-        // this var is not found
-        std::cout << "error!!! 404 nf " << std::endl;
-        // error
+}
+
+void handleGroup(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    if (!parseArgument(args[1], pid)) {
+        return;
+    }
+    reportStatus(ctx->sim->joinGroup(pid, std::string(args[2])), pid, ctx);
+}
+
+void handleShmCreate(const TokenList& args, CommandContext *ctx)
+{
+    uint64_t size;
+    DataType type = Char;
+    if (!parseArgument(args[2], size)) {
+        return;
+    }
+    if (args.size() > 3 && !dataTypeFromName(args[3], type)) {
+        // error: unknown data type
+        std::cout << "error: unknown data type" << std::endl;
+        return;
+    }
+    reportStatus(ctx->sim->createSegment(std::string(args[1]), type, size), ALL_PROCESSES, ctx);
+}
+
+void handleShmAttach(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    if (!parseArgument(args[1], pid)) {
+        return;
+    }
+    uint64_t address;
+    if (reportStatus(ctx->sim->attachSegment(pid, std::string(args[2]), &address), pid, ctx)) {
+        std::cout << address << std::endl;
+    }
+}
+
+void handleShmDetach(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    if (!parseArgument(args[1], pid)) {
+        return;
+    }
+    reportStatus(ctx->sim->detachSegment(pid, std::string(args[2])), pid, ctx);
+}
+
+void handleShmDestroy(const TokenList& args, CommandContext *ctx)
+{
+    reportStatus(ctx->sim->destroySegment(std::string(args[1])), ALL_PROCESSES, ctx);
+}
+
+void handlePolicy(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    int node = -1;
+    NumaPolicy policy;
+    if (!parseArgument(args[1], pid)) {
+        return;
+    }
+    if (args[2] == "local") {
+        policy = PolicyLocal;
+    } else if (args[2] == "interleave") {
+        policy = PolicyInterleave;
+    } else if (args[2] == "bind") {
+        policy = PolicyBind;
+    } else {
+        std::cout << "error: unknown policy '" << args[2] << "'" << std::endl;
+        return;
+    }
+    if (args.size() > 3 && !parseArgument(args[3], node)) {
+        return;
+    }
+    if (policy == PolicyBind && node < 0) {
+        std::cout << "error: usage is policy <PID> bind <node>" << std::endl;
+    } else {
+        reportStatus(ctx->sim->setPolicy(pid, policy, node), pid, ctx);
+    }
+}
+
+void handleMigrate(const TokenList& args, CommandContext *ctx)
+{
+    uint32_t pid;
+    int node;
+    if (!parseArgument(args[1], pid) || !parseArgument(args[2], node)) {
+        return;
+    }
+    int moved;
+    if (reportStatus(ctx->sim->migrate(pid, node, &moved), pid, ctx)) {
+        std::cout << moved << std::endl;
+    }
+}
+
+// cache l1|l2|llc <size> <ways> <line_size> <latency> [lru|fifo|random]
+// cache tlb <entries> <ways> <latency> <walk_cost> [lru|fifo|random]
+// cache off
+void handleCache(const TokenList& args, CommandContext *ctx)
+{
+    if (args[1] == "off") {
+        ctx->sim->disableCache();
+        return;
+    }
+    CacheLevelId level;
+    if (!cacheLevelFromName(args[1], level)) {
+        std::cout << "error: unknown cache level '" << args[1] << "'" << std::endl;
+        return;
+    }
+    if (args.size() < 6) {
+        std::cout << "error: usage is " << (level == LevelTlb ? "cache tlb <entries> <ways> <latency> <walk_cost> [<policy>]"
+                                                             : "cache <level> <size> <ways> <line_size> <latency> [<policy>]") << std::endl;
+        return;
+    }
+    uint64_t size;
+    uint32_t ways, line_size, latency, walk_cost;
+    CacheReplacement replacement = ReplaceLru;
+    if (!parseArgument(args[2], size) || !parseArgument(args[3], ways)) {
+        return;
+    }
+    if (level == LevelTlb) {
+        if (!parseArgument(args[4], latency) || !parseArgument(args[5], walk_cost)) {
+            return;
+        }
+    } else if (!parseArgument(args[4], line_size) || !parseArgument(args[5], latency)) {
         return;
     }
-    double start_page_double;
-    double end_page_double;
-    int start_page_int;
-    int end_page_int;
-    start_page_double = ((double)variableList[idxToRemove]->virtual_address) / (double)page_table->getPageSize();
-    start_page_int = floor(start_page_double); // index, 0 ~ n
-    end_page_double = ((double)variableList[idxToRemove]->size + (double)variableList[idxToRemove]->virtual_address) / (double)page_table->getPageSize();
-    end_page_int = floor(end_page_double); // index, 0 ~ n
-    mmu->removeVariableFromProcess(pid, var_name);
-    std::vector<int> deletePages = mmu->mergeFreeSpace(pid, page_table->getPageSize());
-    if (deletePages[0] != -1) {
-        for (int p = 0; p < deletePages.size(); p++) {
-            page_table->deleteEntry(pid, deletePages[p]);
+    if (args.size() > 6 && !cacheReplacementFromName(args[6], replacement)) {
+        std::cout << "error: unknown replacement policy '" << args[6] << "'" << std::endl;
+        return;
+    }
+    if (level == LevelTlb) {
+        reportStatus(ctx->sim->configureTlb(size, ways, latency, walk_cost, replacement), ALL_PROCESSES, ctx);
+    } else {
+        reportStatus(ctx->sim->configureCache(level, size, ways, line_size, latency, replacement), ALL_PROCESSES, ctx);
+    }
+}
+
+void handleTrack(const TokenList& args, CommandContext *ctx)
+{
+    uint64_t window = 10000;
+    uint64_t interval = 1000;
+    if (args[1] != "on" && args[1] != "off") {
+        std::cout << "error: usage is track on|off [<window> [<scan_interval>]]" << std::endl;
+        return;
+    }
+    if (args.size() > 2 && !parseArgument(args[2], window)) {
+        return;
+    }
+    if (args.size() > 3 && !parseArgument(args[3], interval)) {
+        return;
+    }
+    reportStatus(ctx->sim->setTracking(args[1] == "on", window, interval), ALL_PROCESSES, ctx);
+}
+
+void handleDedup(const TokenList& args, CommandContext *ctx)
+{
+    if (args.size() == 1) {
+        std::cout << ctx->sim->dedupPass() << std::endl;
+    } else if (args[1] == "off") {
+        ctx->sim->setDedupBackground(0);
+    } else if (args[1] == "auto" && args.size() > 2) {
+        size_t pages;
+        if (parseArgument(args[2], pages)) {
+            ctx->sim->setDedupBackground(pages);
         }
+    } else {
+        std::cout << "error: usage is dedup [auto <pages> | off]" << std::endl;
     }
 }
 
-void terminateProcess(uint32_t pid, Mmu *mmu, PageTable *page_table)
+void handleZswap(const TokenList& args, CommandContext *ctx)
 {
-    page_table->deleteProcessEntry(pid);
-    mmu->removeProcessFromMmu(pid);
+    size_t limit = 0;
+    if (args[1] != "off" && !parseArgument(args[1], limit)) {
+        return;
+    }
+    ctx->sim->setZswapLimit(limit);
+}
+
+// geometry <bits_0> ... <bits_N>, root level first
+void handleGeometry(const TokenList& args, CommandContext *ctx)
+{
+    std::vector<int> bits(args.size() - 1);
+    for (size_t i = 1; i < args.size(); i++) {
+        if (!parseArgument(args[i], bits[i - 1])) {
+            return;
+        }
+    }
+    reportStatus(ctx->sim->setGeometry(bits), ALL_PROCESSES, ctx);
+}
+
+void handleStats(const TokenList& args, CommandContext *)
+{
+    if (!STATS_ENABLED) {
+        std::cout << "error: statistics were disabled at compile time" << std::endl;
+    } else if (args.size() == 1) {
+        StatsRegistry::print(std::cout);
+    } else if (args.size() == 3 && args[1] == "json") {
+        std::string file_name(args[2]);
+        if (!StatsRegistry::writeJson(file_name)) {
+            std::cout << "error: could not write " << file_name << std::endl;
+        }
+    } else {
+        std::cout << "error: usage is stats [json <file>]" << std::endl;
+    }
+}
+
+static int formatValue(char *buf, size_t size, char value) { return snprintf(buf, size, "%c", value); }
+static int formatValue(char *buf, size_t size, short value) { return snprintf(buf, size, "%hd", value); }
+static int formatValue(char *buf, size_t size, int value) { return snprintf(buf, size, "%d", value); }
+static int formatValue(char *buf, size_t size, float value) { return snprintf(buf, size, "%f", value); }
+static int formatValue(char *buf, size_t size, long value) { return snprintf(buf, size, "%ld", value); }
+static int formatValue(char *buf, size_t size, double value) { return snprintf(buf, size, "%f", value); }
+
+void printVariable(uint32_t pid, Variable *var, Simulator *sim)
+{
+    dispatchDataType(var->type, [&](auto tag) {
+        typedef decltype(tag) T;
+        uint64_t items = var->size / sizeof(T);
+        T values[4];
+        uint32_t shown = std::min(items, (uint64_t)4); // print first 4 items
+        SimStatus status = sim->read(pid, var->name, 0, values, shown);
+        if (status != SimOk) {
+            std::cout << "error: " << sim->statusMessage(status, pid) << std::endl;
+            return;
+        }
+
+        std::string out;
+        char buf[64];
+        for (uint32_t h = 0; h < shown; h++) {
+            if (h > 0) {
+                out += ", ";
+            }
+            out.append(buf, formatValue(buf, sizeof(buf), values[h]));
+        }
+        if (items > 4) { // do we have more than 4 items?
+            out += ", ... [" + std::to_string(items) + " items]";
+        }
+        std::cout << out << std::endl;
+    });
+}
+
+// A node is given as <bytes>[:<local_cost>[:<remote_cost>]]; remote accesses default to
+// twice the local cost. A spec that does not parse is SimInvalidNode.
+SimStatus addNumaNode(Simulator *sim, std::string_view spec)
+{
+    uint64_t bytes;
+    uint32_t local_cost = 100;
+    uint32_t remote_cost;
+    size_t colon = spec.find(':');
+    if (!parseValue(spec.substr(0, colon), bytes)) {
+        return SimInvalidNode;
+    }
+    if (colon != std::string_view::npos) {
+        spec.remove_prefix(colon + 1);
+        colon = spec.find(':');
+        if (!parseValue(spec.substr(0, colon), local_cost)) {
+            return SimInvalidNode;
+        }
+    }
+    remote_cost = local_cost * 2;
+    if (colon != std::string_view::npos && !parseValue(spec.substr(colon + 1), remote_cost)) {
+        return SimInvalidNode;
+    }
+    return sim->addNode(bytes, local_cost, remote_cost);
+}
+
+void printStartMessage(int page_size)
+{
+    std::cout << "Welcome to the Memory Allocation Simulator! Using a page size of " << page_size << " bytes." << std:: endl;
+    std::cout << "Commands:" << std:: endl;
+    std::cout << "  * create <text_size> <data_size> (initializes a new process)" << std:: endl;
+    std::cout << "  * allocate <PID> <var_name> <data_type> <number_of_elements> (allocated memory on the heap)" << std:: endl;
+    std::cout << "  * set <PID> <var_name> <offset> <value_0> <value_1> <value_2> ... <value_N> (set the value for a variable)" << std:: endl;
+    std::cout << "  * free <PID> <var_name> (deallocate memory on the heap that is associated with <var_name>)" << std:: endl;
+    std::cout << "  * terminate <PID> (kill the specified process)" << std:: endl;
+    std::cout << "  * limit <PID> <bytes> | limit group <name> <bytes> | limit system <bytes> (cap committed memory, 0 for unlimited)" << std:: endl;
+    std::cout << "  * group <PID> <name> (move a process into an accounting group)" << std:: endl;
+    std::cout << "  * print <object> (prints data)" << std:: endl;
+    std::cout << "    * If <object> is \"mmu\", print the MMU memory table" << std:: endl;
+    std::cout << "    * if <object> is \"page [<PID>|all] [<start> [<count>]]\", print the page table (optionally one process, one page of rows)" << std:: endl;
+    std::cout << "    * if <object> is \"processes\", print a list of PIDs for processes that are still running" << std:: endl;
+    std::cout << "    * if <object> is \"memstat\", print allocation, residency and fragmentation metrics" << std:: endl;
+    std::cout << "    * if <object> is \"accounting\", print committed memory and limits per process and group" << std:: endl;
+    std::cout << "    * if <object> is \"heat <PID>\", print per-page access counts, referenced/dirty bits and a heat bar" << std:: endl;
+    std::cout << "    * if <object> is \"geometry\", print page table levels, the memory their tables take and references per walk" << std:: endl;
+    std::cout << "    * if <object> is \"zswap\", print compressed pool occupancy, compression ratio and latencies" << std:: endl;
+    std::cout << "    * if <object> is \"dedup\", print frames saved by merging identical pages and the cost of scanning" << std:: endl;
+    std::cout << "    * if <object> is \"wss\", print each process' estimated working-set size" << std:: endl;
+    std::cout << "    * if <object> is \"cache\", print TLB and cache hit rates per level and per process, and the average memory access time" << std:: endl;
+    std::cout << "    * if <object> is \"numa\", print memory node occupancy and access counters, and process placement policies" << std:: endl;
+    std::cout << "    * if <object> is \"shm\", print shared memory segments and the processes attached to them" << std:: endl;
+    std::cout << "    * if <object> is a \"<PID>:<var_name>\", print the value of the variable for that process" << std:: endl;
+    std::cout << "  * fill <PID> <var_name> <offset> <count> <value> (set <count> elements starting at <offset> to one value)" << std:: endl;
+    std::cout << "  * copy <PID>:<src_var> <PID>:<dst_var> (copy elements between two variables of the same type)" << std:: endl;
+    std::cout << "  * sum <PID>:<var_name> (print the sum of a variable's elements)" << std:: endl;
+    std::cout << "  * shmcreate <name> <size> [<data_type>] (create a shared memory segment of <size> bytes, char by default)" << std:: endl;
+    std::cout << "  * shmattach <PID> <name> (map a shared memory segment into a process as variable <name>)" << std:: endl;
+    std::cout << "  * shmdetach <PID> <name> (unmap a shared memory segment; it is freed after the last process detaches)" << std:: endl;
+    std::cout << "  * shmdestroy <name> (free a shared memory segment that no process has attached)" << std:: endl;
+    std::cout << "  * policy <PID> local [<node>] | interleave | bind <node> (choose which memory node new pages of a process go to)" << std:: endl;
+    std::cout << "  * migrate <PID> <node> (move a process' private pages to a node and make it the process' home node)" << std:: endl;
+    std::cout << "  * cache <l1|l2|llc> <size> <ways> <line_size> <latency> [lru|fifo|random] (configure a cache level; resets the cache counters)" << std:: endl;
+    std::cout << "  * cache tlb <entries> <ways> <latency> <walk_cost> [lru|fifo|random] | cache off (configure the TLB, or turn the cache model off)" << std:: endl;
+    std::cout << "  * track on|off [<window> [<scan_interval>]] (page access tracking; the working set is the pages used in the last <window> translations)" << std:: endl;
+    std::cout << "  * dedup [auto <pages> | off] (merge identical frames now, or scan <pages> pages in the background after every command)" << std:: endl;
+    std::cout << "  * zswap <pool_bytes> | off (compress cold pages into a pool of up to <pool_bytes> when frames run out)" << std:: endl;
+    std::cout << "  * geometry <bits_0> ... <bits_N> (page table levels and the page number bits each indexes, root first; only before any process is created)" << std:: endl;
+    std::cout << "  * stats [json <file>] (print command latencies and internal counters, or dump them as JSON)" << std:: endl;
+    std::cout << std::endl;
 }
@@ -0,0 +1,655 @@
+#include "memsim.h"
+#include "stats.h"
+#include "output.h"
+#include <stdlib.h>
+#include <string.h>
+
+static SimStatus fromAccountingStatus(AccountingStatus status)
+{
+    switch (status) {
+        case AccountExceedsSystem:  return SimExceedsSystem;
+        case AccountExceedsProcess: return SimExceedsProcess;
+        case AccountExceedsGroup:   return SimExceedsGroup;
+        default:                    return SimOk;
+    }
+}
+
+Simulator::Simulator(int page_size)
+{
+    _page_size = page_size;
+    _numa = new NumaMemory(page_size);
+    _memory = NULL;
+    _accounting = NULL;
+    _mmu = NULL;
+    _page_table = NULL;
+    _cache = NULL;
+    _access = NULL;
+    _shm = NULL;
+}
+
+Simulator::~Simulator()
+{
+    delete _shm;
+    delete _access;
+    delete _page_table;
+    delete _cache;
+    delete _mmu;
+    delete _accounting;
+    delete _numa;
+    free(_memory);
+}
+
+SimStatus Simulator::addNode(uint64_t bytes, uint32_t local_cost, uint32_t remote_cost)
+{
+    if (_page_size <= 0) {
+        return SimInvalidPageSize;
+    } else if (_memory != NULL || !_numa->addNode(bytes, local_cost, remote_cost)) {
+        return SimInvalidNode;
+    }
+    return SimOk;
+}
+
+SimStatus Simulator::init()
+{
+    if (_page_size <= 0) {
+        return SimInvalidPageSize;
+    } else if (_numa->getNodeCount() == 0) {
+        _numa->addNode(DEFAULT_MEMORY_SIZE, 100, 200);
+    }
+
+    // Create physical 'memory'
+    _memory = (uint8_t*)calloc(_numa->getMemorySize(), 1);
+    if (_memory == NULL) {
+        return SimOutOfMemory;
+    }
+
+    // Create MMU and Page Table, which share one view of committed memory
+    _accounting = new Accounting(_numa->getMemorySize());
+    _mmu = new Mmu(DEFAULT_MEMORY_SIZE, _accounting);
+    _cache = new CacheHierarchy(_page_size);
+    _page_table = new PageTable(_page_size, _accounting, _numa, _memory, _cache);
+    _access = new MemoryAccess(_page_table, _memory, _cache);
+    _shm = new SharedMemory(_page_table);
+    return SimOk;
+}
+
+// A process that cannot get all of its <TEXT>, <GLOBALS> and <STACK> is not created
+SimStatus Simulator::createProcess(uint64_t text_size, uint64_t data_size, uint32_t *pid)
+{
+    uint64_t stack_size = 65536;
+    //   - create new process in the MMU
+    *pid = _mmu->createProcess();
+    //   - allocate new variables for the <TEXT>, <GLOBALS>, and <STACK>
+    SimStatus status = placeVariable(*pid, "<TEXT>", DataType::Char, text_size, NULL);
+    if (status == SimOk) {
+        status = placeVariable(*pid, "<GLOBALS>", DataType::Char, data_size, NULL);
+    }
+    if (status == SimOk) {
+        status = placeVariable(*pid, "<STACK>", DataType::Char, stack_size, NULL);
+    }
+    if (status != SimOk) {
+        terminate(*pid);
+    }
+    return status;
+}
+
+SimStatus Simulator::allocate(uint32_t pid, const std::string& name, DataType type, uint64_t count, uint64_t *address)
+{
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    } else if (_mmu->doWeHaveVariable(pid, name)) {
+        return SimVariableExists;
+    }
+    return placeVariable(pid, name, type, count, address);
+}
+
+SimStatus Simulator::placeVariable(uint32_t pid, const std::string& name, DataType type, uint64_t count, uint64_t *address_out)
+{
+    // Get the total size of this new var
+    int sizeOfType = dataTypeSize(type);
+    // Sizes that overflow can never fit, so let them fail the free space search
+    uint64_t sizeInTotal = count > UINT64_MAX / sizeOfType ? UINT64_MAX : count * sizeOfType;
+    // Get variableList
+    std::vector<Variable*> variableList = _mmu->getVariableList(pid);
+
+    int idxToInsert = -1;
+    // Loop through the varList to find the middle spot that next to <free space>
+    for (int i = 0; i < variableList.size(); i++) {
+        if (variableList[i]->name == "<FREE_SPACE>") {
+            STATS_INC(FreeSegmentScans);
+            if (variableList[i]->size >= sizeInTotal) {
+                idxToInsert = i;
+                break;
+            }
+        }
+    }
+
+    if (idxToInsert == -1) {
+        // no free space in that process which means it exceeds its address space
+        return SimOutOfVirtualSpace;
+    }
+
+    // Reject up front, before any hole or page is created for this variable
+    uint64_t sizeWithHole = sizeInTotal;
+    if (idxToInsert != 0) {
+        uint64_t leftover = _page_size - ((variableList[idxToInsert-1]->size + variableList[idxToInsert-1]->virtual_address) % _page_size);
+        if (sizeInTotal > leftover) {
+            sizeWithHole += leftover % sizeOfType;
+        }
+    }
+    AccountingStatus status = _mmu->checkAllocation(pid, sizeWithHole, idxToInsert);
+    if (status != AccountOk) {
+        return fromAccountingStatus(status);
+    }
+    if (sizeInTotal > 0) {
+        // Every page past the one the previous variable ends in is new, as is that one if unmapped
+        uint64_t start = 0;
+        if (idxToInsert != 0) {
+            start = variableList[idxToInsert-1]->virtual_address + variableList[idxToInsert-1]->size;
+        }
+        uint64_t newPages = (start + sizeWithHole - 1) / _page_size - start / _page_size + 1;
+        if (_page_table->lookUpTable(pid, start / _page_size)) {
+            newPages--;
+        }
+        if (!_page_table->canMapPages(pid, newPages)) {
+            return SimOutOfFrames;
+        }
+    }
+
+    // VariableList looks like: [<TEXT>, <GLOBALS>, <STACK>, thisIsAnInt, <FREE_SPACE>]
+    //                                                                   ^
+    //                                                   each time we insert the new var here
+
+    uint64_t page_size = _page_size;
+    uint64_t address = 0;
+    if (idxToInsert != 0) { // if the new var has a neighbor on its left
+        address = variableList[idxToInsert-1]->size + variableList[idxToInsert-1]->virtual_address;
+        uint64_t leftover = page_size - address % page_size;
+        if (sizeInTotal > leftover && leftover % sizeOfType != 0) { // if leftover can't be divided with no remainder by type size
+            uint64_t shortSpaceSize = leftover % sizeOfType;
+            // we get a small hole in between, so that no element straddles two pages
+            _mmu->addVariableToProcess(pid, "<FREE_SPACE>", DataType::Char, shortSpaceSize, address, idxToInsert);
+            idxToInsert++; // go right by 1 index
+            address += shortSpaceSize;
+        }
+    }
+    // Map every page the new var touches that is not on the book yet
+    if (sizeInTotal > 0) {
+        for (uint64_t i = address / page_size; i <= (address + sizeInTotal - 1) / page_size; i++) {
+            if (!_page_table->lookUpTable(pid, i)) {
+                _page_table->addEntry(pid, i);
+            }
+        }
+    }
+    _mmu->addVariableToProcess(pid, name, type, sizeInTotal, address, idxToInsert);
+    if (address_out != NULL) {
+        *address_out = address;
+    }
+    return SimOk;
+}
+
+// Freeing a shared mapping detaches it
+SimStatus Simulator::freeVariable(uint32_t pid, const std::string& name)
+{
+    Variable *var;
+    SimStatus status = findVariable(pid, name, &var);
+    if (status != SimOk) {
+        return status;
+    }
+    bool shared = var->shared;
+    _mmu->removeVariableFromProcess(pid, name);
+    std::vector<std::pair<uint64_t, uint64_t>> deletePages = _mmu->mergeFreeSpace(pid, _page_size);
+    for (int p = 0; p < deletePages.size(); p++) {
+        _page_table->deleteRange(pid, deletePages[p].first, deletePages[p].second);
+    }
+    if (shared) {
+        _shm->detach(pid, name);
+    }
+    return SimOk;
+}
+
+SimStatus Simulator::terminate(uint32_t pid)
+{
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    }
+    _page_table->deleteProcessEntry(pid);
+    _mmu->removeProcessFromMmu(pid);
+    _shm->detachProcess(pid);
+    return SimOk;
+}
+
+SimStatus Simulator::findVariable(uint32_t pid, const std::string& name, Variable **var)
+{
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    } else if (!_mmu->doWeHaveVariable(pid, name)) {
+        return SimVariableNotFound;
+    }
+    *var = _mmu->findVariable(pid, name);
+    return SimOk;
+}
+
+// Look the variable up and reject element ranges of the wrong type or that run past its end
+SimStatus Simulator::checkAccess(uint32_t pid, const std::string& name, DataType type, uint64_t offset, uint64_t count, Variable **var)
+{
+    SimStatus status = findVariable(pid, name, var);
+    if (status != SimOk) {
+        return status;
+    } else if ((*var)->type != type) {
+        return SimTypeMismatch;
+    }
+    uint64_t elements = (*var)->size / dataTypeSize(type);
+    if (offset > elements || count > elements - offset) {
+        return SimIndexOutOfRange;
+    }
+    return SimOk;
+}
+
+// Copies as many elements as the smaller of the two variables holds
+SimStatus Simulator::copy(uint32_t src_pid, const std::string& src_name, uint32_t dst_pid, const std::string& dst_name)
+{
+    Variable *src;
+    Variable *dst;
+    SimStatus status = findVariable(src_pid, src_name, &src);
+    if (status == SimOk) {
+        status = findVariable(dst_pid, dst_name, &dst);
+    }
+    if (status != SimOk) {
+        return status;
+    } else if (src->type != dst->type) {
+        return SimTypeMismatch;
+    }
+    static thread_local std::vector<uint8_t> buffer;
+    buffer.resize(std::min(src->size, dst->size));
+    if (!_access->readBytes(src_pid, src->virtual_address, buffer.data(), buffer.size()) ||
+        !_access->writeBytes(dst_pid, dst->virtual_address, buffer.data(), buffer.size())) {
+        return SimBadAddress;
+    }
+    return SimOk;
+}
+
+SimStatus Simulator::createSegment(const std::string& name, DataType type, uint64_t size)
+{
+    if (!_page_table->canMapPages(ALL_PROCESSES, size / _page_size + (size % _page_size != 0))) {
+        return SimOutOfFrames;
+    }
+    SharedSegment *segment = _shm->create(name, type, size);
+    if (segment == NULL) {
+        return SimSegmentExists;
+    }
+    // Recycled frames may hold old data
+    for (int i = 0; i < segment->frames.size(); i++) {
+        memset(_memory + (size_t)segment->frames[i] * _page_size, 0, _page_size);
+    }
+    return SimOk;
+}
+
+// Map a shared segment into a process as a variable named after the segment. The mapping
+// starts on a page boundary and covers whole pages, so no private variable ever lands
+// in a shared frame.
+SimStatus Simulator::attachSegment(uint32_t pid, const std::string& name, uint64_t *address_out)
+{
+    SharedSegment *segment = _shm->find(name);
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    } else if (segment == NULL) {
+        return SimSegmentNotFound;
+    } else if (_mmu->doWeHaveVariable(pid, name)) {
+        return SimVariableExists;
+    }
+
+    uint64_t page_size = _page_size;
+    std::vector<Variable*> variableList = _mmu->getVariableList(pid);
+
+    int idxToInsert = -1;
+    uint64_t address;
+    for (int i = 0; i < variableList.size(); i++) {
+        if (variableList[i]->name == "<FREE_SPACE>") {
+            STATS_INC(FreeSegmentScans);
+            uint64_t start = variableList[i]->virtual_address;
+            address = (start + page_size - 1) / page_size * page_size;
+            if (address + segment->size <= start + variableList[i]->size) {
+                idxToInsert = i;
+                break;
+            }
+        }
+    }
+    if (idxToInsert == -1) {
+        return SimOutOfVirtualSpace;
+    }
+
+    uint64_t shortSpaceSize = address - variableList[idxToInsert]->virtual_address;
+    AccountingStatus status = _mmu->checkAllocation(pid, shortSpaceSize + segment->size, idxToInsert);
+    if (status != AccountOk) {
+        return fromAccountingStatus(status);
+    }
+    if (shortSpaceSize > 0) { // hole up to the page boundary
+        _mmu->addVariableToProcess(pid, "<FREE_SPACE>", DataType::Char, shortSpaceSize, variableList[idxToInsert]->virtual_address, idxToInsert);
+        idxToInsert++;
+    }
+    for (int i = 0; i < segment->frames.size(); i++) {
+        _page_table->addSharedEntry(pid, address / page_size + i, segment->frames[i]);
+    }
+    _mmu->addVariableToProcess(pid, segment->name, segment->type, segment->size, address, idxToInsert);
+    _mmu->findVariable(pid, segment->name)->shared = true;
+    segment->attached.insert(pid);
+    if (address_out != NULL) {
+        *address_out = address;
+    }
+    return SimOk;
+}
+
+SimStatus Simulator::detachSegment(uint32_t pid, const std::string& name)
+{
+    Variable *var;
+    SimStatus status = findVariable(pid, name, &var);
+    if (status != SimOk) {
+        return status;
+    } else if (!var->shared) {
+        return SimNotShared;
+    }
+    return freeVariable(pid, name);
+}
+
+SimStatus Simulator::destroySegment(const std::string& name)
+{
+    SharedSegment *segment = _shm->find(name);
+    if (segment == NULL) {
+        return SimSegmentNotFound;
+    } else if (!segment->attached.empty()) {
+        return SimSegmentAttached;
+    }
+    _shm->destroy(name);
+    return SimOk;
+}
+
+// pid names the process whose limit an allocation ran into
+std::string Simulator::statusMessage(SimStatus status, uint32_t pid)
+{
+    switch (status) {
+        case SimOk:                   return "";
+        case SimProcessNotFound:      return "process not found";
+        case SimVariableNotFound:     return "variable not found";
+        case SimVariableExists:       return "variable already exists";
+        case SimSegmentNotFound:      return "shared memory segment not found";
+        case SimSegmentExists:        return "shared memory segment already exists";
+        case SimSegmentAttached:      return "shared memory segment is still attached";
+        case SimNotShared:            return "variable is not a shared memory segment";
+        case SimOutOfVirtualSpace:    return "not enough free virtual address space";
+        case SimOutOfFrames:          return "not enough free frames";
+        case SimBadAddress:           return "page could not be mapped into a frame";
+        case SimExceedsSystem:        return _accounting->statusMessage(AccountExceedsSystem, pid);
+        case SimExceedsProcess:       return _accounting->statusMessage(AccountExceedsProcess, pid);
+        case SimExceedsGroup:         return _accounting->statusMessage(AccountExceedsGroup, pid);
+        case SimIndexOutOfRange:      return "index out of range";
+        case SimTypeMismatch:         return "variables have different data types";
+        case SimInvalidNode:          return "invalid memory node";
+        case SimNodeNotFound:         return "node not found";
+        case SimInvalidCacheSize:     return "size must be a nonzero multiple of ways * line size";
+        case SimInvalidScanInterval:  return "scan interval must be at least 1";
+        case SimTooManyLevels:        return "a page table has at most " + std::to_string(MAX_PAGE_TABLE_LEVELS) + " levels";
+        case SimInvalidLevelBits:     return "a level indexes 1 to 30 bits";
+        case SimAddressSpaceTooLarge: return "address space too large for a page size of " + std::to_string(_page_size) + " bytes";
+        case SimPagesMapped:          return "geometry can only be changed while no pages are mapped";
+        case SimInvalidPageSize:      return "page size must be a positive number of bytes";
+        case SimOutOfMemory:          return "could not allocate physical memory";
+    }
+    return "";
+}
+
+SimStatus Simulator::setSystemLimit(uint64_t bytes)
+{
+    _accounting->setSystemLimit(bytes);
+    return SimOk;
+}
+
+SimStatus Simulator::setGroupLimit(const std::string& group, uint64_t bytes)
+{
+    _accounting->setGroupLimit(group, bytes);
+    return SimOk;
+}
+
+SimStatus Simulator::setProcessLimit(uint32_t pid, uint64_t bytes)
+{
+    return _accounting->setProcessLimit(pid, bytes) ? SimOk : SimProcessNotFound;
+}
+
+SimStatus Simulator::joinGroup(uint32_t pid, const std::string& group)
+{
+    return _accounting->joinGroup(pid, group) ? SimOk : SimProcessNotFound;
+}
+
+SimStatus Simulator::setPolicy(uint32_t pid, NumaPolicy policy, int node)
+{
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    } else if (!_numa->setPolicy(pid, policy, node)) {
+        return SimNodeNotFound;
+    }
+    return SimOk;
+}
+
+// Moves the process' private pages to the node and makes it the process' home
+SimStatus Simulator::migrate(uint32_t pid, int node, int *moved)
+{
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    } else if (node < 0 || node >= _numa->getNodeCount()) {
+        return SimNodeNotFound;
+    }
+    *moved = _page_table->migrate(pid, node);
+    return SimOk;
+}
+
+SimStatus Simulator::configureCache(CacheLevelId level, uint64_t size, uint32_t ways, uint32_t line_size, uint32_t latency, CacheReplacement replacement)
+{
+    if (level == LevelTlb) {
+        return configureTlb(size, ways, latency, 0, replacement);
+    } else if (ways == 0 || line_size == 0 || size == 0 || size % ((uint64_t)ways * line_size) != 0) {
+        return SimInvalidCacheSize;
+    }
+    _cache->setLevel(level, new CacheLevel(size, ways, line_size, latency, replacement));
+    return SimOk;
+}
+
+// The TLB is a cache level of one-entry lines
+SimStatus Simulator::configureTlb(uint64_t entries, uint32_t ways, uint32_t latency, uint32_t walk_cost, CacheReplacement replacement)
+{
+    if (ways == 0 || entries == 0 || entries % ways != 0) {
+        return SimInvalidCacheSize;
+    }
+    _cache->setLevel(LevelTlb, new CacheLevel(entries, ways, 1, latency, replacement));
+    _cache->setWalkCost(walk_cost);
+    return SimOk;
+}
+
+void Simulator::disableCache()
+{
+    _cache->disable();
+}
+
+SimStatus Simulator::setTracking(bool tracking, uint64_t window, uint64_t interval)
+{
+    if (interval == 0) {
+        return SimInvalidScanInterval;
+    }
+    _page_table->setTracking(tracking, window, interval);
+    return SimOk;
+}
+
+int Simulator::dedupPass()
+{
+    return _page_table->dedupPass();
+}
+
+void Simulator::setDedupBackground(size_t pages)
+{
+    _page_table->setDedupBackground(pages);
+}
+
+void Simulator::backgroundWork()
+{
+    _page_table->backgroundWork();
+}
+
+void Simulator::setZswapLimit(size_t bytes)
+{
+    _page_table->setZswapLimit(bytes);
+}
+
+// Each level indexes bits[i] bits of the page number; e.g. 9 9 9 9 is x86-64 four-level
+// paging with 4 KB pages
+SimStatus Simulator::setGeometry(const std::vector<int>& bits)
+{
+    if (bits.size() > MAX_PAGE_TABLE_LEVELS) {
+        return SimTooManyLevels;
+    }
+    int total = 0;
+    for (size_t i = 0; i < bits.size(); i++) {
+        if (bits[i] < 1 || bits[i] > 30) {
+            return SimInvalidLevelBits;
+        }
+        total += bits[i];
+    }
+    if (total > PAGE_NUMBER_BITS || (uint64_t)_page_size > (1ULL << (63 - total))) {
+        return SimAddressSpaceTooLarge;
+    } else if (!_page_table->setGeometry(bits)) {
+        return SimPagesMapped;
+    }
+    _mmu->setVirtualSize(_page_table->getVirtualSize());
+    return SimOk;
+}
+
+void Simulator::printMmu(std::ostream& out)
+{
+    _mmu->print(out);
+}
+
+void Simulator::printPageTable(uint32_t pid, size_t start, size_t count, std::ostream& out)
+{
+    _page_table->print(pid, start, count, out);
+}
+
+void Simulator::printProcesses(std::ostream& out)
+{
+    _mmu->printProcesses(out);
+}
+
+void Simulator::printMemStat(std::ostream& out)
+{
+    std::vector<uint32_t> pids = _mmu->getProcessIds();
+
+    out << " PID  | Virtual Bytes | PT Entries | Align Holes | Free Segs | Largest Hole" << std::endl;
+    out << "------+---------------+------------+-------------+-----------+--------------" << std::endl;
+    int entries = 0; // shared, merged and compressed pages make this differ from the frame count
+    for (int i = 0; i < pids.size(); i++)
+    {
+        entries += _page_table->getEntryCount(pids[i]);
+        const MemStat& stat = _mmu->getMemStat(pids[i]);
+        unsigned long long largest = stat.free_segments.empty() ? 0 : *stat.free_segments.rbegin();
+        streamPrintf(out, " %4u | %13llu | %10d | %11llu | %9lu | %12llu \n", pids[i], (unsigned long long)stat.virtual_bytes,
+               _page_table->getEntryCount(pids[i]), (unsigned long long)stat.alignment_hole_bytes,
+               stat.free_segments.size(), largest);
+    }
+    const MemStat& global = _mmu->getGlobalMemStat();
+    unsigned long long largest = global.free_segments.empty() ? 0 : *global.free_segments.rbegin();
+    out << "------+---------------+------------+-------------+-----------+--------------" << std::endl;
+    streamPrintf(out, " %4s | %13llu | %10d | %11llu | %9lu | %12llu \n", "all", (unsigned long long)global.virtual_bytes,
+           entries, (unsigned long long)global.alignment_hole_bytes,
+           global.free_segments.size(), largest);
+    streamPrintf(out, " Frames resident: %d (%llu bytes)\n", _page_table->getFrameCount(),
+           (unsigned long long)_page_table->getFrameCount() * _page_size);
+}
+
+void Simulator::printAccounting(std::ostream& out)
+{
+    _accounting->print(out);
+}
+
+void Simulator::printSharedMemory(std::ostream& out)
+{
+    _shm->print(out);
+}
+
+SimStatus Simulator::printHeat(uint32_t pid, std::ostream& out)
+{
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    }
+    _page_table->printHeat(pid, out);
+    return SimOk;
+}
+
+void Simulator::printZswap(std::ostream& out)
+{
+    _page_table->printZswap(out);
+}
+
+void Simulator::printGeometry(std::ostream& out)
+{
+    _page_table->printGeometry(out);
+}
+
+void Simulator::printDedup(std::ostream& out)
+{
+    _page_table->printDedup(out);
+}
+
+void Simulator::printWorkingSets(std::ostream& out)
+{
+    _page_table->printWorkingSets(out);
+}
+
+void Simulator::printCache(std::ostream& out)
+{
+    _cache->print(out);
+}
+
+void Simulator::printNuma(std::ostream& out)
+{
+    _numa->print(out);
+}
+
+SimStatus Simulator::translate(uint32_t pid, uint64_t virtual_address, uint64_t *physical_address)
+{
+    if (!_mmu->doWeHaveProcess(pid)) {
+        return SimProcessNotFound;
+    }
+    int64_t address = _page_table->getPhysicalAddress(pid, virtual_address);
+    if (address < 0) {
+        return SimBadAddress;
+    }
+    *physical_address = address;
+    return SimOk;
+}
+
+int Simulator::reclaimFrames(int pages)
+{
+    return _page_table->reclaimFrames(pages);
+}
+
+int Simulator::getPageSize()
+{
+    return _page_size;
+}
+
+uint64_t Simulator::getMemorySize()
+{
+    return _numa->getMemorySize();
+}
+
+int Simulator::getFrameCount()
+{
+    return _page_table->getFrameCount();
+}
+
+int Simulator::getMergedFrameCount()
+{
+    return _page_table->getMergedFrameCount();
+}
+
+int Simulator::getEntryCount(uint32_t pid)
+{
+    return _page_table->getEntryCount(pid);
+}
@@ -1,10 +1,16 @@
 #include "mmu.h"
+#include "stats.h"
 #include <math.h>
+#include <stdio.h>
+#include <algorithm>
 
-Mmu::Mmu(int memory_size)
+Mmu::Mmu(uint64_t memory_size, Accounting *accounting)
 {
     _next_pid = 1024;
     _max_size = memory_size;
+    _accounting = accounting;
+    _global_stat.virtual_bytes = 0;
+    _global_stat.alignment_hole_bytes = 0;
 }
 
 Mmu::~Mmu()
@@ -21,15 +27,20 @@ uint32_t Mmu::createProcess()
     var->type = DataType::FreeSpace;
     var->virtual_address = 0;
     var->size = _max_size;
+    var->alignment_hole = false;
+    var->shared = false;
     proc->variables.push_back(var);
+    proc->stat.virtual_bytes = 0;
+    proc->stat.alignment_hole_bytes = 0;
 
     _processes.push_back(proc);
+    _accounting->addProcess(proc->pid);
 
     _next_pid++;
     return proc->pid;
 }
 
-void Mmu::addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint32_t size, uint32_t address, int idxToInsert)
+AccountingStatus Mmu::addVariableToProcess(uint32_t pid, std::string var_name, DataType type, uint64_t size, uint64_t address, int idxToInsert)
 {
     int i;
     Process *proc = NULL;
@@ -41,17 +52,13 @@ void Mmu::addVariableToProcess(uint32_t pid, std::string var_name, DataType type
         }
     }
 
-    // Print error message if an allocation would exceed system memory (and don't perform allocation)
-    uint32_t cal = 0;
-    if (idxToInsert == proc->variables.size() - 1) { // if insert at the end
-        for (int j = 0; j < _processes.size(); j++) {
-            cal += _processes[j]->variables[_processes[j]->variables.size() - 1]->virtual_address;
-        }
+    // Don't perform an allocation that would exceed system memory or a limit
+    AccountingStatus status = checkAllocation(pid, size, idxToInsert);
+    if (status != AccountOk) {
+        return status;
     }
-    cal += size;
-    if (cal > 67108864) {
-        std::cout << "error: this allocation would exceed system memory" << std::endl;
-        return;
+    if (idxToInsert == proc->variables.size() - 1) {
+        _accounting->charge(pid, size);
     }
 
     Variable *var = new Variable();
@@ -59,40 +66,54 @@ void Mmu::addVariableToProcess(uint32_t pid, std::string var_name, DataType type
     var->type = type;
     var->virtual_address = address;
     var->size = size;
+    var->alignment_hole = (var_name == "<FREE_SPACE>");
+    var->shared = false;
     if (proc != NULL)
     {
+        trackFreeSegment(proc, idxToInsert, false);
+        if (proc->variables[idxToInsert]->alignment_hole) { // reusing an alignment hole
+            proc->stat.alignment_hole_bytes -= size;
+            _global_stat.alignment_hole_bytes -= size;
+        }
         proc->variables[idxToInsert]->size -= size;
         proc->variables[idxToInsert]->virtual_address += size;
         proc->variables.insert(proc->variables.begin() + idxToInsert, var);
-        
-        if (var_name != "<TEXT>" && var_name != "<GLOBALS>" && var_name != "<STACK>" && var_name != "<FREE_SPACE>") {
-            std::cout << var->virtual_address << std::endl;
+        trackFreeSegment(proc, idxToInsert + 1, true);
+        if (var->alignment_hole) {
+            proc->stat.alignment_hole_bytes += size;
+            _global_stat.alignment_hole_bytes += size;
+        } else {
+            proc->stat.virtual_bytes += size;
+            _global_stat.virtual_bytes += size;
         }
-        /*std::cout << var->name << "---name" << std::endl;
-        std::cout << proc->variables.size() << "---size"<< std::endl;
-        std::cout << var->virtual_address + var->size << "---ending addr"<< std::endl;*/
     }
+    return AccountOk;
 }
 
-void Mmu::print()
+void Mmu::print(std::ostream& out)
 {
     int i, j;
+    std::string buffer;
+    char line[128];
 
-    std::cout << " PID  | Variable Name | Virtual Addr | Size" << std::endl;
-    std::cout << "------+---------------+--------------+------------" << std::endl;
+    buffer += " PID  | Variable Name | Virtual Addr | Size\n";
+    buffer += "------+---------------+--------------+------------\n";
     for (i = 0; i < _processes.size(); i++)
     {
         uint32_t pid = _processes[i]->pid;
         for (j = 0; j < _processes[i]->variables.size(); j++)
         {
             std::string var_name = _processes[i]->variables[j]->name;
-            uint32_t vir_addr = _processes[i]->variables[j]->virtual_address;
-            uint32_t var_size = _processes[i]->variables[j]->size;
+            uint64_t vir_addr = _processes[i]->variables[j]->virtual_address;
+            uint64_t var_size = _processes[i]->variables[j]->size;
             if (var_name != "<FREE_SPACE>") {
-                printf(" %4u | %-13s |  0x%08X  | %10u \n", pid, var_name.c_str(), vir_addr, var_size);
+                int len = snprintf(line, sizeof(line), " %4u | %-13s |  0x%08llX  | %10llu \n", pid, var_name.c_str(),
+                                   (unsigned long long)vir_addr, (unsigned long long)var_size);
+                buffer.append(line, std::min(len, (int)sizeof(line) - 1));
             }
         }
     }
+    out << buffer;
 }
 
 DataType Mmu::getVariableType(uint32_t pid, std::string var_name) {
@@ -111,7 +132,6 @@ DataType Mmu::getVariableType(uint32_t pid, std::string var_name) {
             return proc->variables[j]->type;
         }
     }
-    std::cout << "We got a bug in Mmu::getVariableType." << std::endl;
     return FreeSpace;
 }
 
@@ -167,7 +187,6 @@ Variable* Mmu::findVariable(uint32_t pid, std::string var_name) {
             return proc->variables[j];
         }
     }
-    std::cout << "We got a bug in Mmu::findVariable." << std::endl;
     return NULL;
 }
 
@@ -184,9 +203,9 @@ std::vector<Variable*> Mmu::getVariableList(uint32_t pid) {
     return proc->variables;
 }
 
-void Mmu::printProcesses() {
+void Mmu::printProcesses(std::ostream& out) {
     for (int i = 0; i < _processes.size(); i++) {
-        std::cout << _processes[i]->pid << std::endl;
+        out << _processes[i]->pid << std::endl;
     }
 }
 
@@ -204,14 +223,19 @@ void Mmu::removeVariableFromProcess(uint32_t pid, std::string var_name) {
         if (proc->variables[j]->name == var_name)
         {
             proc->variables[j]->name = "<FREE_SPACE>";
+            proc->stat.virtual_bytes -= proc->variables[j]->size;
+            _global_stat.virtual_bytes -= proc->variables[j]->size;
+            trackFreeSegment(proc, j, true);
         }
     }
 }
 
-std::vector<int> Mmu::mergeFreeSpace(uint32_t pid, int page_size) {
+// Merge neighbouring free segments and return the (first, last) ranges of pages that
+// are no longer used by any variable
+std::vector<std::pair<uint64_t, uint64_t>> Mmu::mergeFreeSpace(uint32_t pid, int page_size) {
     int i;
     Process *proc = NULL;
-    std::vector<int> retVec;
+    std::vector<std::pair<uint64_t, uint64_t>> retVec;
     for (i = 0; i < _processes.size(); i++)
     {
         if (_processes[i]->pid == pid)
@@ -223,44 +247,42 @@ std::vector<int> Mmu::mergeFreeSpace(uint32_t pid, int page_size) {
     while (j < proc->variables.size() - 1) { // merge
         int flag = 0;
         if (proc->variables[j]->name == "<FREE_SPACE>" && proc->variables[j+1]->name == "<FREE_SPACE>") {
+            trackFreeSegment(proc, j, false);
+            trackFreeSegment(proc, j + 1, false);
+            for (int h = j; h <= j + 1; h++) { // a merged hole is no longer an alignment hole
+                if (proc->variables[h]->alignment_hole) {
+                    proc->stat.alignment_hole_bytes -= proc->variables[h]->size;
+                    _global_stat.alignment_hole_bytes -= proc->variables[h]->size;
+                    proc->variables[h]->alignment_hole = false;
+                }
+            }
+            if (j + 1 == proc->variables.size() - 1) { // the end of the used address space moves back
+                _accounting->uncharge(pid, proc->variables[j]->size);
+            }
             proc->variables[j]->size += proc->variables[j+1]->size;
             flag = 1;
+            STATS_INC(FreeSpaceMerges);
         }
         if (flag == 1) {
             proc->variables.erase(proc->variables.begin() + j + 1); // delete right one
+            trackFreeSegment(proc, j, true);
         } else {
             j++;
         }
     }
     for (int k = 0; k < proc->variables.size(); k++) { // pages need to be deleted
         if (proc->variables[k]->name == "<FREE_SPACE>") {
-            double start_page_double;
-            double end_page_double;
-            int start_page_int;
-            int end_page_int;
-            start_page_double = ((double)proc->variables[k]->virtual_address) / (double)page_size;
-            start_page_int = floor(start_page_double); // index, 0 ~ n
-            end_page_double = ((double)proc->variables[k]->size + (double)proc->variables[k]->virtual_address) / (double)page_size;
-            end_page_int = floor(end_page_double); // index, 0 ~ n
-            if (start_page_int + 1 < end_page_int) {
-                for (int d = start_page_int + 1; d < end_page_int; d++) {
-                    retVec.push_back(d);
-                }
-            }
-            if ((proc->variables[k]->virtual_address % page_size == 0) && (start_page_int != end_page_int)) { // start at the beginning of the page
-                retVec.push_back(start_page_int);
-            }
-            if (((proc->variables[k]->virtual_address + proc->variables[k]->size) % page_size == 0) && (start_page_int != end_page_int)) { // end at the end of the page
-                retVec.push_back(end_page_int);
+            // Only pages that lie entirely inside the free segment can go
+            uint64_t start = proc->variables[k]->virtual_address;
+            uint64_t end = start + proc->variables[k]->size;
+            uint64_t first_page = (start + page_size - 1) / page_size;
+            uint64_t end_page = end / page_size; // first page past the segment
+            if (first_page < end_page) {
+                retVec.push_back(std::make_pair(first_page, end_page - 1));
             }
         }
     }
-    if (retVec.empty()) {
-        retVec.push_back(-1);
-        return retVec;
-    } else {
-        return retVec;
-    }
+    return retVec;
 }
 
 void Mmu::removeProcessFromMmu(uint32_t pid) {
@@ -268,7 +290,75 @@ void Mmu::removeProcessFromMmu(uint32_t pid) {
     {
         if (_processes[i]->pid == pid)
         {
+            MemStat& stat = _processes[i]->stat;
+            _global_stat.virtual_bytes -= stat.virtual_bytes;
+            _global_stat.alignment_hole_bytes -= stat.alignment_hole_bytes;
+            std::multiset<uint64_t>::iterator it;
+            for (it = stat.free_segments.begin(); it != stat.free_segments.end(); it++) {
+                _global_stat.free_segments.erase(_global_stat.free_segments.find(*it));
+            }
             _processes.erase(_processes.begin() + i);
+            _accounting->removeProcess(pid);
+        }
+    }
+}
+
+// Only growing the end of a process' address space commits new memory, so allocations
+// that reuse a hole are always admitted
+AccountingStatus Mmu::checkAllocation(uint32_t pid, uint64_t size, int idxToInsert) {
+    Process *proc = findProcess(pid);
+    if (idxToInsert != proc->variables.size() - 1) {
+        return AccountOk;
+    }
+    return _accounting->check(pid, size);
+}
+
+std::vector<uint32_t> Mmu::getProcessIds() {
+    std::vector<uint32_t> pids;
+    for (int i = 0; i < _processes.size(); i++) {
+        pids.push_back(_processes[i]->pid);
+    }
+    return pids;
+}
+
+const MemStat& Mmu::getMemStat(uint32_t pid) {
+    return findProcess(pid)->stat;
+}
+
+const MemStat& Mmu::getGlobalMemStat() {
+    return _global_stat;
+}
+
+Accounting* Mmu::getAccounting() {
+    return _accounting;
+}
+
+// Applies to processes created from now on
+void Mmu::setVirtualSize(uint64_t size) {
+    _max_size = size;
+}
+
+Process* Mmu::findProcess(uint32_t pid) {
+    for (int i = 0; i < _processes.size(); i++) {
+        if (_processes[i]->pid == pid) {
+            return _processes[i];
         }
     }
+    return NULL;
+}
+
+// Add or remove the free segment at idx from the hole sets. Only holes between variables
+// count: the trailing free space, empty segments and alignment holes are skipped.
+void Mmu::trackFreeSegment(Process *proc, int idx, bool insert) {
+    Variable *var = proc->variables[idx];
+    if (var->name != "<FREE_SPACE>" || var->size == 0 || var->alignment_hole || idx == proc->variables.size() - 1) {
+        return;
+    }
+    if (insert) {
+        proc->stat.free_segments.insert(var->size);
+        _global_stat.free_segments.insert(var->size);
+    } else {
+        proc->stat.free_segments.erase(proc->stat.free_segments.find(var->size));
+        _global_stat.free_segments.erase(_global_stat.free_segments.find(var->size));
+    }
 }
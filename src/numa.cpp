@@ -0,0 +1,236 @@
+#include "numa.h"
+#include "pagetable.h"
+#include "stats.h"
+#include "output.h"
+#include <stdio.h>
+#include <algorithm>
+
+NumaMemory::NumaMemory(int page_size)
+{
+    _page_size = page_size;
+    _next_home = 0;
+}
+
+NumaMemory::~NumaMemory()
+{
+}
+
+// Nodes are laid out in physical memory in the order they are added
+bool NumaMemory::addNode(uint64_t bytes, uint32_t local_cost, uint32_t remote_cost)
+{
+    // Frame numbers are ints
+    if (bytes < (uint64_t)_page_size || bytes / _page_size > (uint64_t)(INT32_MAX - getFrameCount())) {
+        return false;
+    }
+    NumaNode node = {};
+    node.first_frame = getFrameCount();
+    node.frame_count = bytes / _page_size;
+    node.local_cost = local_cost;
+    node.remote_cost = remote_cost;
+    _nodes.push_back(node);
+
+    _fallback.push_back(_nodes.size() - 1);
+    std::stable_sort(_fallback.begin(), _fallback.end(), [this](int a, int b) {
+        return _nodes[a].remote_cost < _nodes[b].remote_cost;
+    });
+    return true;
+}
+
+int NumaMemory::getNodeCount()
+{
+    return _nodes.size();
+}
+
+int NumaMemory::getFrameCount()
+{
+    if (_nodes.empty()) {
+        return 0;
+    }
+    return _nodes.back().first_frame + _nodes.back().frame_count;
+}
+
+uint64_t NumaMemory::getMemorySize()
+{
+    return (uint64_t)getFrameCount() * _page_size;
+}
+
+NumaProcess& NumaMemory::process(uint32_t pid)
+{
+    std::unordered_map<uint32_t, NumaProcess>::iterator it = _processes.find(pid);
+    if (it == _processes.end()) {
+        NumaProcess proc = {PolicyLocal, _next_home, _next_home};
+        _next_home = (_next_home + 1) % _nodes.size();
+        it = _processes.emplace(pid, proc).first;
+    }
+    return it->second;
+}
+
+// Read-only view for queries; a process with no frames yet is reported with the home it
+// would get next, without taking that node from the rotation
+NumaProcess NumaMemory::lookUpProcess(uint32_t pid)
+{
+    std::unordered_map<uint32_t, NumaProcess>::iterator it = _processes.find(pid);
+    if (it == _processes.end()) {
+        return NumaProcess{PolicyLocal, _next_home, _next_home};
+    }
+    return it->second;
+}
+
+int NumaMemory::freeFrames(int node)
+{
+    return _nodes[node].frame_count - _nodes[node].frames_in_use;
+}
+
+// Always hand out the lowest free frame of the node
+int NumaMemory::allocateFrameOnNode(int node)
+{
+    NumaNode& n = _nodes[node];
+    if (n.frames_in_use == n.frame_count) {
+        return -1;
+    }
+    int frame;
+    if (!n.released_frames.empty()) {
+        frame = *n.released_frames.begin();
+        n.released_frames.erase(n.released_frames.begin());
+    } else {
+        frame = n.first_frame + n.next_frame++;
+    }
+    n.frames_in_use++;
+    return frame;
+}
+
+int NumaMemory::allocateFrame(uint32_t pid)
+{
+    if (pid == ALL_PROCESSES) {
+        for (int i = 0; i < _fallback.size(); i++) {
+            int frame = allocateFrameOnNode(_fallback[i]);
+            if (frame >= 0) {
+                return frame;
+            }
+        }
+        return -1;
+    }
+
+    NumaProcess& proc = process(pid);
+    if (proc.policy == PolicyBind) {
+        return allocateFrameOnNode(proc.home);
+    } else if (proc.policy == PolicyInterleave) {
+        for (int i = 0; i < _nodes.size(); i++) {
+            int node = proc.next_interleave;
+            proc.next_interleave = (proc.next_interleave + 1) % _nodes.size();
+            int frame = allocateFrameOnNode(node);
+            if (frame >= 0) {
+                return frame;
+            }
+        }
+        return -1;
+    }
+    // Local: the home node first, then the cheapest node to reach from elsewhere
+    int frame = allocateFrameOnNode(proc.home);
+    for (int i = 0; frame < 0 && i < _fallback.size(); i++) {
+        frame = allocateFrameOnNode(_fallback[i]);
+    }
+    return frame;
+}
+
+void NumaMemory::releaseFrame(int frame)
+{
+    NumaNode& n = _nodes[nodeOf(frame)];
+    n.released_frames.insert(frame);
+    n.frames_in_use--;
+}
+
+int NumaMemory::freeFramesFor(uint32_t pid)
+{
+    if (pid != ALL_PROCESSES) {
+        NumaProcess proc = lookUpProcess(pid);
+        if (proc.policy == PolicyBind) {
+            return freeFrames(proc.home);
+        }
+    }
+    int total = 0;
+    for (int i = 0; i < _nodes.size(); i++) {
+        total += freeFrames(i);
+    }
+    return total;
+}
+
+int NumaMemory::nodeOf(int frame)
+{
+    int node = 0;
+    while (node + 1 < _nodes.size() && frame >= _nodes[node + 1].first_frame) {
+        node++;
+    }
+    return node;
+}
+
+uint32_t NumaMemory::accessCost(uint32_t pid, int frame)
+{
+    int node = nodeOf(frame);
+    return lookUpProcess(pid).home == node ? _nodes[node].local_cost : _nodes[node].remote_cost;
+}
+
+void NumaMemory::recordAccess(uint32_t pid, int frame)
+{
+    int node = nodeOf(frame);
+    NumaNode& n = _nodes[node];
+    if (lookUpProcess(pid).home == node) {
+        n.local_accesses++;
+        n.access_cost += n.local_cost;
+    } else {
+        n.remote_accesses++;
+        n.access_cost += n.remote_cost;
+        STATS_INC(RemoteAccesses);
+    }
+}
+
+bool NumaMemory::setPolicy(uint32_t pid, NumaPolicy policy, int node)
+{
+    if (node >= (int)_nodes.size()) {
+        return false;
+    }
+    NumaProcess& proc = process(pid);
+    proc.policy = policy;
+    if (node >= 0) {
+        proc.home = node;
+    }
+    return true;
+}
+
+void NumaMemory::setHomeNode(uint32_t pid, int node)
+{
+    process(pid).home = node;
+}
+
+void NumaMemory::removeProcess(uint32_t pid)
+{
+    _processes.erase(pid);
+}
+
+void NumaMemory::print(std::ostream& out)
+{
+    static const char *policy_names[] = {"local", "interleave", "bind"};
+
+    out << " Node | Frames     | In Use     | Local Cost | Remote Cost | Local Acc  | Remote Acc | Access Cost" << std::endl;
+    out << "------+------------+------------+------------+-------------+------------+------------+-------------" << std::endl;
+    for (int i = 0; i < _nodes.size(); i++) {
+        NumaNode& n = _nodes[i];
+        streamPrintf(out, " %4d | %10d | %10d | %10u | %11u | %10llu | %10llu | %11llu \n", i, n.frame_count, n.frames_in_use,
+               n.local_cost, n.remote_cost, (unsigned long long)n.local_accesses,
+               (unsigned long long)n.remote_accesses, (unsigned long long)n.access_cost);
+    }
+
+    std::vector<uint32_t> pids;
+    std::unordered_map<uint32_t, NumaProcess>::iterator it;
+    for (it = _processes.begin(); it != _processes.end(); it++) {
+        pids.push_back(it->first);
+    }
+    std::sort(pids.begin(), pids.end());
+    out << std::endl;
+    out << " PID  | Policy     | Home" << std::endl;
+    out << "------+------------+------" << std::endl;
+    for (int i = 0; i < pids.size(); i++) {
+        NumaProcess& proc = _processes[pids[i]];
+        streamPrintf(out, " %4u | %-10s | %4d \n", pids[i], policy_names[proc.policy], proc.home);
+    }
+}
@@ -0,0 +1,26 @@
+#include "output.h"
+#include <ostream>
+#include <string>
+#include <stdarg.h>
+#include <stdio.h>
+
+void streamPrintf(std::ostream& out, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len < 0) {
+        return;
+    }
+    if ((size_t)len < sizeof(line)) {
+        out.write(line, len);
+        return;
+    }
+    std::string long_line(len + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&long_line[0], long_line.size(), format, args);
+    va_end(args);
+    out.write(long_line.data(), len);
+}
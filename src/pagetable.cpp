@@ -1,108 +1,204 @@
 #include "pagetable.h"
+#include "stats.h"
+#include "output.h"
+#include <stdio.h>
+#include <algorithm>
+#include <string.h>
+#include <chrono>
 
-PageTable::PageTable(int page_size)
+PageTable::PageTable(int page_size, Accounting *accounting, NumaMemory *numa, void *memory, CacheHierarchy *cache)
+    : _zswap(page_size)
 {
     _page_size = page_size;
+    _accounting = accounting;
+    _numa = numa;
+    _frame_refs.resize(numa->getFrameCount(), 0);
+    _frames_in_use = 0;
+    _tracking = true;
+    _clock = 0;
+    _wss_window = 10000;
+    _scan_interval = 1000;
+    _next_scan = _scan_interval;
+    _wss_cursor = PageKey(0, 0);
+    _memory = (uint8_t*)memory;
+    _frame_merged.resize(numa->getFrameCount(), false);
+    _dedup_cursor = PageKey(0, 0);
+    _dedup_background = 0;
+    _dedup = DedupStats();
+    _reclaim_cursor = PageKey(0, 0);
+    _cache = cache;
+    // One level covering the default address space, like the original flat table
+    int bits = 1;
+    while (((uint64_t)page_size << bits) < DEFAULT_MEMORY_SIZE) {
+        bits++;
+    }
+    setGeometry(std::vector<int>(1, bits));
 }
 
 PageTable::~PageTable()
 {
 }
 
-std::vector<std::string> PageTable::sortedKeys()
+// Returns a frame holding one reference for the caller, placed by the process' policy,
+// or -1 if there is no room for it
+int PageTable::allocateFrame(uint32_t pid)
 {
-    std::vector<std::string> keys;
+    return claimFrame(_numa->allocateFrame(pid));
+}
 
-    std::map<std::string, int>::iterator it;
-    for (it = _table.begin(); it != _table.end(); it++)
-    {
-        keys.push_back(it->first);
+int PageTable::allocateFrameOnNode(int node)
+{
+    return claimFrame(_numa->allocateFrameOnNode(node));
+}
+
+int PageTable::claimFrame(int frame)
+{
+    if (frame < 0) {
+        return -1;
     }
+    _frame_refs[frame] = 1;
+    _frame_merged[frame] = false;
+    _frames_in_use++;
+    _accounting->claimFrames(1);
+    STATS_INC(FramesInUse);
+    return frame;
+}
 
-    std::sort(keys.begin(), keys.end(), PageTableKeyComparator());
+// Drops one reference; the frame is free again once nothing refers to it. A merged frame
+// left with a single owner needs no copy before it is written.
+void PageTable::releaseFrame(int frame)
+{
+    _frame_refs[frame]--;
+    if (_frame_refs[frame] == 1) {
+        _frame_merged[frame] = false;
+    } else if (_frame_refs[frame] == 0) {
+        _numa->releaseFrame(frame);
+        _frames_in_use--;
+        _accounting->claimFrames(-1);
+        STATS_DEC(FramesInUse);
+    }
+}
 
-    return keys;
+// Compresses cold pages into the zswap pool, if it is on, to make room
+bool PageTable::canMapPages(uint32_t pid, uint64_t pages)
+{
+    int64_t missing = (int64_t)pages - _numa->freeFramesFor(pid);
+    if (missing > 0 && missing <= _numa->getFrameCount() && _zswap.isEnabled()) {
+        reclaimFrames((int)missing);
+    }
+    return (uint64_t)_numa->freeFramesFor(pid) >= pages;
 }
 
-void PageTable::addEntry(uint32_t pid, int page_number)
+void PageTable::addEntry(uint32_t pid, uint64_t page_number)
 {
     // Combination of pid and page number act as the key to look up frame number
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    int frame = 0;
-    std::vector<std::string> keys = sortedKeys();
-    // Find free frame
-    if (_table.empty()) {
-        _table[entry] = 0;
-        return;
-    }
-    int flag = -1;
-    for (int i = 0; i < 65536; i++) {
-        if (flag != -1) {
-            break;
-        }
-        for (int j = 0; j < keys.size(); j++) {
-            if (_table[keys[j]] == i) { // find this frame
-                break;
-            }
-            if (j == keys.size() - 1) { // last loop
-                flag = i;
-            }
-        }
-    }
-    frame = flag;
-    _table[entry] = frame;
+    STATS_INC(PageTableInserts);
+    _process_entries[pid]++;
+    _accounting->chargeFrames(pid, 1);
+    updateLevelTables(pageTableKey(pid, page_number), 1);
+    _working_sets[pid]++;
+    _table[pageTableKey(pid, page_number)] = PageEntry{allocateFrame(pid), false, false, false, true, 0, _clock};
 }
 
-int PageTable::getPhysicalAddress(uint32_t pid, uint32_t virtual_address)
+// Map a page onto a frame that is already in use, e.g. by a shared memory segment
+void PageTable::addSharedEntry(uint32_t pid, uint64_t page_number, int frame)
+{
+    STATS_INC(PageTableInserts);
+    _frame_refs[frame]++;
+    _process_entries[pid]++;
+    _accounting->chargeFrames(pid, 1);
+    updateLevelTables(pageTableKey(pid, page_number), 1);
+    _working_sets[pid]++;
+    _table[pageTableKey(pid, page_number)] = PageEntry{frame, false, false, false, true, 0, _clock};
+}
+
+int64_t PageTable::getPhysicalAddress(uint32_t pid, uint64_t virtual_address, bool write)
 {
     // Convert virtual address to page_number and page_offset
-    int page_number = virtual_address / _page_size;
-    int page_offset = virtual_address % _page_size;
+    uint64_t page_number = virtual_address / _page_size;
+    uint64_t page_offset = virtual_address % _page_size;
 
     // Combination of pid and page number act as the key to look up frame number
     // !!! We are using frame number here !!!
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    
     // If entry exists, look up frame number and convert virtual to physical address
-    int address = -1;
-    if (_table.count(entry) > 0)
+    int64_t address = -1;
+    STATS_INC(PageTableLookups);
+    std::map<PageKey, PageEntry>::iterator it = _table.find(pageTableKey(pid, page_number));
+    int references = walkReferences(pageTableKey(pid, page_number), it != _table.end());
+    _walks++;
+    _walk_references += references;
+    STATS_ADD(PageWalkReferences, references);
+    if (it != _table.end())
     {
-        address = _table[entry] * _page_size + page_offset;
+        PageEntry& entry = it->second;
+        if (entry.compressed && !swapIn(it->first, entry)) {
+            return -1;
+        }
+        if (write && _frame_merged[entry.frame] && !unmergeEntry(it->first, entry)) {
+            return -1;
+        }
+        if (_tracking) {
+            entry.referenced = true;
+            entry.dirty |= write;
+            entry.accesses++;
+            entry.last_use = _clock;
+            if (!entry.in_working_set) {
+                entry.in_working_set = true;
+                _working_sets[pid]++;
+            }
+            if (++_clock >= _next_scan) {
+                scanWorkingSets(_scan_interval);
+            }
+        }
+        _numa->recordAccess(pid, entry.frame);
+        address = (int64_t)entry.frame * _page_size + page_offset;
     }
 
     return address;
 }
 
-void PageTable::print()
+// Streams the entries of one process (or all of them) in (pid, page) order, skipping the
+// first `start` rows and stopping after `count`. Output is formatted into one buffer and
+// written once.
+void PageTable::print(uint32_t pid, size_t start, size_t count, std::ostream& out)
 {
-    int i;
-
-    std::cout << " PID  | Page Number | Frame Number" << std::endl;
-    std::cout << "------+-------------+--------------" << std::endl;
-
-    std::vector<std::string> keys = sortedKeys();
+    std::map<PageKey, PageEntry>::iterator it = _table.begin();
+    std::map<PageKey, PageEntry>::iterator end = _table.end();
+    if (pid != ALL_PROCESSES) {
+        it = _table.lower_bound(pageTableKey(pid, 0));
+        end = _table.lower_bound(pageTableKey(pid + 1, 0));
+    }
+    for (size_t skipped = 0; skipped < start && it != end; skipped++) {
+        it++;
+    }
 
-    for (i = 0; i < keys.size(); i++)
+    std::string buffer;
+    char line[64];
+    buffer.reserve(128 + 36 * std::min(count, _table.size()));
+    buffer += " PID  | Page Number | Frame Number\n";
+    buffer += "------+-------------+--------------\n";
+    for (size_t printed = 0; printed < count && it != end; printed++, it++)
     {
-        std::string del = "|";
-        std::string temp = keys.at(i);
-        int frame_number = _table[keys.at(i)];
-        size_t pos = temp.find(del);
-        std::string pid = temp.substr(0, pos);
-        temp.erase(0, (pos + del.length()));
-        int temp2 = stoi(temp);
-        temp2--;
-        printf(" %4s | %11d | %12d \n", pid.c_str(), temp2, frame_number);
+        uint32_t entry_pid = it->first.first;
+        unsigned long long page_number = it->first.second;
+        int len;
+        if (it->second.compressed) {
+            len = snprintf(line, sizeof(line), " %4u | %11llu | %12s \n", entry_pid, page_number, "zswap");
+        } else {
+            len = snprintf(line, sizeof(line), " %4u | %11llu | %12d \n", entry_pid, page_number, it->second.frame);
+        }
+        buffer.append(line, len);
     }
+    out << buffer;
 }
 
 int PageTable::getPageSize() {
     return _page_size;
 }
 
-bool PageTable::lookUpTable(uint32_t pid, int page_number) {
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    if (_table.count(entry) > 0) {
+bool PageTable::lookUpTable(uint32_t pid, uint64_t page_number) {
+    STATS_INC(PageTableLookups);
+    if (_table.count(pageTableKey(pid, page_number)) > 0) {
         // found
         return true;
     } else {
@@ -111,19 +207,462 @@ bool PageTable::lookUpTable(uint32_t pid, int page_number) {
     }
 }
 
-void PageTable::deleteEntry(uint32_t pid, int page_number) {
-    std::string entry = std::to_string(pid) + "|" + std::to_string(page_number);
-    if (_table.count(entry) > 0) {
-        _table.erase(entry);
+void PageTable::deleteEntry(uint32_t pid, uint64_t page_number) {
+    std::map<PageKey, PageEntry>::iterator it = _table.find(pageTableKey(pid, page_number));
+    if (it != _table.end()) {
+        if (it->second.compressed) {
+            _zswap.drop(it->first.first, it->first.second);
+        } else {
+            releaseFrame(it->second.frame);
+        }
+        invalidateTranslation(it->first);
+        uncountWorkingSet(it->first, it->second);
+        updateLevelTables(it->first, -1);
+        _table.erase(it);
+        _process_entries[pid]--;
+        _accounting->chargeFrames(pid, -1);
+        STATS_INC(PageTableDeletes);
     }
     
 }
 
+void PageTable::eraseEntries(uint32_t pid, std::map<PageKey, PageEntry>::iterator it, std::map<PageKey, PageEntry>::iterator end) {
+    while (it != end) {
+        if (it->second.compressed) {
+            _zswap.drop(it->first.first, it->first.second);
+        } else {
+            releaseFrame(it->second.frame);
+        }
+        _process_entries[pid]--;
+        _accounting->chargeFrames(pid, -1);
+        STATS_INC(PageTableDeletes);
+        invalidateTranslation(it->first);
+        uncountWorkingSet(it->first, it->second);
+        updateLevelTables(it->first, -1);
+        it = _table.erase(it);
+    }
+}
+
+// Delete whichever of pages first_page..last_page (inclusive) are mapped
+void PageTable::deleteRange(uint32_t pid, uint64_t first_page, uint64_t last_page) {
+    eraseEntries(pid, _table.lower_bound(pageTableKey(pid, first_page)), _table.upper_bound(pageTableKey(pid, last_page)));
+}
+
 void PageTable::deleteProcessEntry(uint32_t pid) {
-    for (int i = 0; i < 65536; i++) {
-        std::string entry = std::to_string(pid) + "|" + std::to_string(i);
-        if (_table.count(entry) > 0) {
-            _table.erase(entry);
+    // A process' entries are contiguous in the map
+    eraseEntries(pid, _table.lower_bound(pageTableKey(pid, 0)), _table.lower_bound(pageTableKey(pid + 1, 0)));
+    _process_entries.erase(pid);
+    _working_sets.erase(pid);
+    _numa->removeProcess(pid);
+}
+
+int PageTable::getEntryCount(uint32_t pid) {
+    std::unordered_map<uint32_t, int>::iterator it = _process_entries.find(pid);
+    if (it == _process_entries.end()) {
+        return 0;
+    }
+    return it->second;
+}
+
+int PageTable::getFrameCount() {
+    return _frames_in_use;
+}
+
+// Move the process' private pages onto a node and make it the process' home. Frames that
+// are shared with other processes stay where they are. Returns the number of pages moved,
+// stopping early if the node runs out of frames.
+int PageTable::migrate(uint32_t pid, int node) {
+    int moved = 0;
+    std::map<PageKey, PageEntry>::iterator it = _table.lower_bound(pageTableKey(pid, 0));
+    std::map<PageKey, PageEntry>::iterator end = _table.lower_bound(pageTableKey(pid + 1, 0));
+    for (; it != end; it++) {
+        if (it->second.compressed || _frame_refs[it->second.frame] != 1 || _numa->nodeOf(it->second.frame) == node) {
+            continue;
+        }
+        int frame = allocateFrameOnNode(node);
+        if (frame < 0) {
+            break;
+        }
+        memcpy(_memory + (size_t)frame * _page_size, _memory + (size_t)it->second.frame * _page_size, _page_size);
+        releaseFrame(it->second.frame);
+        it->second.frame = frame;
+        invalidateTranslation(it->first);
+        moved++;
+    }
+    _numa->setHomeNode(pid, node);
+    STATS_ADD(PagesMigrated, moved);
+    return moved;
+}
+
+NumaMemory* PageTable::getNuma() {
+    return _numa;
+}
+
+void PageTable::setTracking(bool tracking, uint64_t window, uint64_t interval) {
+    _tracking = tracking;
+    _wss_window = window;
+    _scan_interval = interval;
+    _next_scan = _clock + interval;
+}
+
+// WSClock-style hand: each scan moves it over at most max_pages entries, so with one scan
+// every interval translations tracking costs O(1) per translation however many pages are
+// resident. A translation puts its page in the working set at once; the hand clears
+// referenced bits and takes out the pages last used longer ago than the window.
+void PageTable::scanWorkingSets(size_t max_pages) {
+    std::map<PageKey, PageEntry>::iterator it = _table.lower_bound(_wss_cursor);
+    for (size_t step = 0; step < max_pages && !_table.empty(); step++, it++) {
+        if (it == _table.end()) {
+            it = _table.begin();
+        }
+        PageEntry& entry = it->second;
+        entry.referenced = false;
+        bool in_working_set = _clock - entry.last_use <= _wss_window;
+        if (in_working_set != entry.in_working_set) {
+            _working_sets[it->first.first] += in_working_set ? 1 : -1;
+            entry.in_working_set = in_working_set;
+        }
+    }
+    _wss_cursor = (it == _table.end()) ? PageKey(0, 0) : it->first;
+    _next_scan = _clock + _scan_interval;
+    STATS_INC(WorkingSetScans);
+}
+
+void PageTable::uncountWorkingSet(PageKey key, PageEntry& entry) {
+    if (entry.in_working_set) {
+        _working_sets[key.first]--;
+    }
+}
+
+// As of the last scan
+int PageTable::getWorkingSetSize(uint32_t pid) {
+    std::unordered_map<uint32_t, int>::iterator it = _working_sets.find(pid);
+    if (it == _working_sets.end()) {
+        return 0;
+    }
+    return it->second;
+}
+
+void PageTable::printHeat(uint32_t pid, std::ostream& out) {
+    std::map<PageKey, PageEntry>::iterator it = _table.lower_bound(pageTableKey(pid, 0));
+    std::map<PageKey, PageEntry>::iterator end = _table.lower_bound(pageTableKey(pid + 1, 0));
+    uint32_t hottest = 1;
+    for (std::map<PageKey, PageEntry>::iterator i = it; i != end; i++) {
+        hottest = std::max(hottest, i->second.accesses);
+    }
+
+    const int bar_width = 40;
+    std::string buffer;
+    char line[96];
+    buffer += " Page Number | Frame Number | Accesses   | R | D | Age        | Heat\n";
+    buffer += "-------------+--------------+------------+---+---+------------+------------------------------------------\n";
+    for (; it != end; it++) {
+        PageEntry& entry = it->second;
+        uint64_t age = _clock - entry.last_use;
+        char frame[16];
+        if (entry.compressed) {
+            snprintf(frame, sizeof(frame), "zswap");
+        } else {
+            snprintf(frame, sizeof(frame), "%d", entry.frame);
+        }
+        int len = snprintf(line, sizeof(line), " %11llu | %12s | %10u | %c | %c | %10llu | ", (unsigned long long)it->first.second,
+                           frame, entry.accesses, entry.referenced ? 'R' : '-', entry.dirty ? 'D' : '-',
+                           (unsigned long long)age);
+        buffer.append(line, len);
+        buffer.append((size_t)((uint64_t)entry.accesses * bar_width / hottest), '#');
+        buffer += "\n";
+    }
+    out << buffer;
+}
+
+// Sweeps the hand over the whole table first, so the estimates are current
+void PageTable::printWorkingSets(std::ostream& out) {
+    scanWorkingSets(_table.size());
+    std::vector<uint32_t> pids;
+    std::unordered_map<uint32_t, int>::iterator it;
+    for (it = _process_entries.begin(); it != _process_entries.end(); it++) {
+        pids.push_back(it->first);
+    }
+    std::sort(pids.begin(), pids.end());
+
+    streamPrintf(out, " Window: %llu accesses, scanned every %llu%s\n", (unsigned long long)_wss_window,
+           (unsigned long long)_scan_interval, _tracking ? "" : " (tracking off)");
+    out << " PID  | Resident   | WSS Pages  | WSS Bytes" << std::endl;
+    out << "------+------------+------------+--------------" << std::endl;
+    for (int i = 0; i < pids.size(); i++) {
+        int wss = getWorkingSetSize(pids[i]);
+        streamPrintf(out, " %4u | %10d | %10d | %12llu \n", pids[i], getEntryCount(pids[i]), wss,
+               (unsigned long long)wss * _page_size);
+    }
+}
+
+// Copy-on-write: give the entry its own copy of a merged frame before it is written
+bool PageTable::unmergeEntry(PageKey key, PageEntry& entry) {
+    int frame = allocateFrame(key.first);
+    if (frame < 0) {
+        return false;
+    }
+    memcpy(_memory + (size_t)frame * _page_size, _memory + (size_t)entry.frame * _page_size, _page_size);
+    releaseFrame(entry.frame);
+    entry.frame = frame;
+    invalidateTranslation(key);
+    _dedup.cow_breaks++;
+    STATS_INC(CowBreaks);
+    return true;
+}
+
+static uint64_t hashFrame(const uint8_t *data, size_t size) {
+    // FNV-1a over 8-byte words
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Scan up to max_pages entries from where the last scan stopped, merging each private or
+// already merged frame into an earlier frame of the same pass with identical contents.
+// Frames of shared memory segments are left alone. A candidate's contents may have
+// changed since it was hashed, so every match is checked byte for byte before merging.
+// Returns the number of pages merged.
+int PageTable::dedupScan(size_t max_pages) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int merged = 0;
+    std::map<PageKey, PageEntry>::iterator it = _table.lower_bound(_dedup_cursor);
+    for (size_t scanned = 0; scanned < max_pages && it != _table.end(); scanned++, it++) {
+        PageEntry& entry = it->second;
+        if (entry.compressed || (_frame_refs[entry.frame] > 1 && !_frame_merged[entry.frame])) {
+            continue;
+        }
+        const uint8_t *data = _memory + (size_t)entry.frame * _page_size;
+        uint64_t hash = hashFrame(data, _page_size);
+        _dedup.pages_scanned++;
+        _dedup.bytes_hashed += _page_size;
+
+        bool done = false;
+        std::pair<std::unordered_multimap<uint64_t, int>::iterator, std::unordered_multimap<uint64_t, int>::iterator> range;
+        range = _dedup_candidates.equal_range(hash);
+        for (std::unordered_multimap<uint64_t, int>::iterator c = range.first; c != range.second && !done; c++) {
+            int frame = c->second;
+            if (frame == entry.frame) {
+                done = true;
+                break;
+            }
+            // Skip candidates that were freed or became part of a shared segment since
+            if (_frame_refs[frame] == 0 || (_frame_refs[frame] > 1 && !_frame_merged[frame])) {
+                continue;
+            }
+            _dedup.comparisons++;
+            if (memcmp(data, _memory + (size_t)frame * _page_size, _page_size) == 0) {
+                _frame_refs[frame]++;
+                _frame_merged[frame] = true;
+                releaseFrame(entry.frame);
+                entry.frame = frame;
+                invalidateTranslation(it->first);
+                merged++;
+                done = true;
+            }
+        }
+        if (!done) {
+            _dedup_candidates.emplace(hash, entry.frame);
+        }
+    }
+
+    if (it == _table.end()) { // wrap around and start a new pass
+        _dedup_cursor = PageKey(0, 0);
+        _dedup_candidates.clear();
+        _dedup.passes++;
+    } else {
+        _dedup_cursor = it->first;
+    }
+    _dedup.pages_merged += merged;
+    STATS_ADD(PagesMerged, merged);
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    _dedup.scan_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    return merged;
+}
+
+// One complete pass from the start of the table
+int PageTable::dedupPass() {
+    _dedup_cursor = PageKey(0, 0);
+    _dedup_candidates.clear();
+    return dedupScan(SIZE_MAX);
+}
+
+void PageTable::setDedupBackground(size_t pages) {
+    _dedup_background = pages;
+}
+
+// Called between commands
+void PageTable::backgroundWork() {
+    if (_dedup_background > 0) {
+        dedupScan(_dedup_background);
+    }
+}
+
+int PageTable::getMergedFrameCount() {
+    return std::count(_frame_merged.begin(), _frame_merged.end(), true);
+}
+
+void PageTable::printDedup(std::ostream& out) {
+    int shared_frames = 0;
+    uint64_t saved = 0;
+    for (int frame = 0; frame < _frame_merged.size(); frame++) {
+        if (_frame_merged[frame]) {
+            shared_frames++;
+            saved += _frame_refs[frame] - 1;
+        }
+    }
+    streamPrintf(out, " Merged frames: %d, frames saved: %llu (%llu bytes)\n", shared_frames, (unsigned long long)saved,
+           (unsigned long long)saved * _page_size);
+    streamPrintf(out, " Pages merged: %llu, copy-on-write breaks: %llu\n", (unsigned long long)_dedup.pages_merged,
+           (unsigned long long)_dedup.cow_breaks);
+    streamPrintf(out, " Passes: %llu, pages scanned: %llu, bytes hashed: %llu, comparisons: %llu, scan time: %llu ns\n",
+           (unsigned long long)_dedup.passes, (unsigned long long)_dedup.pages_scanned,
+           (unsigned long long)_dedup.bytes_hashed, (unsigned long long)_dedup.comparisons,
+           (unsigned long long)_dedup.scan_ns);
+    if (_dedup_background > 0) {
+        streamPrintf(out, " Background scan: %llu pages after every command\n", (unsigned long long)_dedup_background);
+    }
+}
+
+// Clock over the page table: a referenced page gets a second chance, an unreferenced private
+// page is compressed into the pool and its frame freed. Stops after `pages` frames or two full turns of the hand.
+// Returns the number of frames freed.
+int PageTable::reclaimFrames(int pages) {
+    int freed = 0;
+    size_t budget = 2 * _table.size();
+    std::map<PageKey, PageEntry>::iterator it = _table.lower_bound(_reclaim_cursor);
+    for (size_t step = 0; step < budget && freed < pages && !_table.empty(); step++, it++) {
+        if (it == _table.end()) {
+            it = _table.begin();
         }
+        PageEntry& entry = it->second;
+        if (entry.compressed || _frame_refs[entry.frame] != 1) {
+            continue;
+        }
+        if (entry.referenced) {
+            entry.referenced = false;
+            continue;
+        }
+        if (_zswap.store(it->first.first, it->first.second, _memory + (size_t)entry.frame * _page_size)) {
+            releaseFrame(entry.frame);
+            entry.frame = -1;
+            entry.compressed = true;
+            invalidateTranslation(it->first);
+            freed++;
+        }
+    }
+    _reclaim_cursor = (it == _table.end()) ? PageKey(0, 0) : it->first;
+    return freed;
+}
+
+// Bring a compressed page back into a frame, compressing another one if memory is full.
+// Fails if there is no frame or the page cannot be decompressed, which leaves it unmapped.
+bool PageTable::swapIn(PageKey key, PageEntry& entry) {
+    int frame = allocateFrame(key.first);
+    if (frame < 0 && reclaimFrames(1) > 0) {
+        frame = allocateFrame(key.first);
+    }
+    if (frame < 0) {
+        return false;
+    }
+    if (!_zswap.load(key.first, key.second, _memory + (size_t)frame * _page_size)) {
+        releaseFrame(frame);
+        return false;
+    }
+    entry.frame = frame;
+    entry.compressed = false;
+    return true;
+}
+
+void PageTable::setZswapLimit(size_t bytes) {
+    _zswap.setLimit(bytes);
+}
+
+void PageTable::printZswap(std::ostream& out) {
+    _zswap.print(out);
+}
+
+void PageTable::invalidateTranslation(PageKey key) {
+    if (_cache != NULL) {
+        _cache->invalidate(key.first, key.second);
+    }
+}
+
+// Counts a mapped page in, or out of, the table it hangs off at every level. A table
+// exists while any page below it is mapped.
+void PageTable::updateLevelTables(PageKey key, int delta) {
+    for (size_t level = 0; level < _level_bits.size(); level++) {
+        PageKey table(key.first, key.second >> _level_shift[level]);
+        int& pages = _level_tables[level][table];
+        pages += delta;
+        if (pages == 0) {
+            _level_tables[level].erase(table);
+        }
+    }
+}
+
+// A walk reads one entry per level until it reaches the page or an entry with no table
+// below it
+int PageTable::walkReferences(PageKey key, bool mapped) {
+    if (mapped) {
+        return _level_bits.size();
+    }
+    int references = 0;
+    for (size_t level = 0; level < _level_bits.size(); level++) {
+        if (_level_tables[level].count(PageKey(key.first, key.second >> _level_shift[level])) == 0) {
+            break;
+        }
+        references++;
+    }
+    return references;
+}
+
+bool PageTable::setGeometry(const std::vector<int>& bits) {
+    if (!_table.empty()) {
+        return false;
+    }
+    _level_bits = bits;
+    _level_shift.assign(bits.size(), 0);
+    int shift = 0;
+    for (int level = bits.size() - 1; level >= 0; level--) {
+        shift += bits[level];
+        _level_shift[level] = shift;
+    }
+    _level_tables.assign(bits.size(), std::map<PageKey, int>());
+    _walks = 0;
+    _walk_references = 0;
+    return true;
+}
+
+uint64_t PageTable::getVirtualSize() {
+    return (uint64_t)_page_size << _level_shift[0];
+}
+
+void PageTable::printGeometry(std::ostream& out) {
+    std::string levels;
+    for (size_t level = 0; level < _level_bits.size(); level++) {
+        levels += (level == 0 ? "" : "+") + std::to_string(_level_bits[level]);
+    }
+    streamPrintf(out, " Levels: %zu (%s bits), %llu bytes of virtual address space per process\n", _level_bits.size(),
+           levels.c_str(), (unsigned long long)getVirtualSize());
+    streamPrintf(out, " Level | Bits | Tables | Table Bytes\n");
+    streamPrintf(out, "-------+------+--------+-------------\n");
+    uint64_t total = 0;
+    for (size_t level = 0; level < _level_bits.size(); level++) {
+        uint64_t bytes = (uint64_t)_level_tables[level].size() * ((uint64_t)8 << _level_bits[level]);
+        total += bytes;
+        streamPrintf(out, " %5zu | %4d | %6zu | %11llu \n", level, _level_bits[level], _level_tables[level].size(),
+               (unsigned long long)bytes);
     }
+    streamPrintf(out, " Table memory: %llu bytes for %zu mapped pages\n", (unsigned long long)total, _table.size());
+    streamPrintf(out, " Walks: %llu, memory references: %llu (%.2f per walk)\n", (unsigned long long)_walks,
+           (unsigned long long)_walk_references, _walks == 0 ? 0.0 : (double)_walk_references / _walks);
 }
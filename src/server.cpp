@@ -0,0 +1,285 @@
+#include "server.h"
+#include <iostream>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static const size_t SERVER_READ_SIZE = 65536;
+static const size_t SERVER_MAX_PENDING_OUTPUT = 1 << 20; // stop reading a session past this
+static const int SERVER_MAX_EVENTS = 64;
+
+Server::Server(const std::string& path, CommandContext *ctx, CommandRunner run)
+{
+    _path = path;
+    _ctx = ctx;
+    _run = run;
+    _listen_fd = -1;
+    _epoll_fd = -1;
+    _signal_fd = -1;
+}
+
+Server::~Server()
+{
+    while (!_sessions.empty()) {
+        closeSession(_sessions.begin()->first);
+    }
+    closeListener();
+    if (_epoll_fd >= 0) {
+        close(_epoll_fd);
+    }
+    if (_signal_fd >= 0) {
+        close(_signal_fd);
+    }
+}
+
+bool Server::listen()
+{
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (_path.size() >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: socket path '%s' is too long\n", _path.c_str());
+        return false;
+    }
+    memcpy(address.sun_path, _path.c_str(), _path.size() + 1);
+
+    // A socket left behind by a server that is gone would make bind fail
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct stat st;
+    if (fd >= 0 && stat(_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+            fprintf(stderr, "Error: another server is listening on '%s'\n", _path.c_str());
+            close(fd);
+            return false;
+        }
+        unlink(_path.c_str());
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listen_fd < 0 || bind(_listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        // Whatever is at the path is not ours, so it stays
+        fprintf(stderr, "Error: cannot bind '%s': %s\n", _path.c_str(), strerror(errno));
+        if (_listen_fd >= 0) {
+            close(_listen_fd);
+            _listen_fd = -1;
+        }
+        return false;
+    }
+    if (::listen(_listen_fd, SOMAXCONN) < 0) {
+        fprintf(stderr, "Error: cannot listen on '%s': %s\n", _path.c_str(), strerror(errno));
+        closeListener();
+        return false;
+    }
+
+    // SIGINT and SIGTERM arrive as events, so the loop can stop and remove the socket
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    _signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_signal_fd < 0 || _epoll_fd < 0) {
+        fprintf(stderr, "Error: cannot set up the event loop: %s\n", strerror(errno));
+        closeListener();
+        return false;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = _listen_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _listen_fd, &event);
+    event.data.fd = _signal_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _signal_fd, &event);
+    return true;
+}
+
+// Closes the bound socket and removes it from the file system
+void Server::closeListener()
+{
+    if (_listen_fd >= 0) {
+        close(_listen_fd);
+        _listen_fd = -1;
+        unlink(_path.c_str());
+    }
+}
+
+void Server::run()
+{
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    for (;;) {
+        int count = epoll_wait(_epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (count < 0 && errno != EINTR) {
+            fprintf(stderr, "Error: epoll_wait failed: %s\n", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == _signal_fd) {
+                return;
+            } else if (fd == _listen_fd) {
+                acceptSessions();
+                continue;
+            }
+            std::unordered_map<int, Session>::iterator it = _sessions.find(fd);
+            if (it == _sessions.end()) {
+                continue;
+            }
+            Session& session = it->second;
+            uint32_t ready = events[i].events;
+            if ((ready & EPOLLOUT) && !writeSession(session)) {
+                continue;
+            }
+            if (ready & EPOLLIN) {
+                readSession(session);
+            } else if (ready & (EPOLLERR | EPOLLHUP)) {
+                closeSession(fd);
+            }
+        }
+    }
+}
+
+void Server::acceptSessions()
+{
+    for (;;) {
+        int fd = accept4(_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // EAGAIN once the backlog is empty
+        }
+        Session& session = _sessions[fd];
+        session.fd = fd;
+        session.events = EPOLLIN;
+        session.closing = false;
+        session.output = "> ";
+        struct epoll_event event = {};
+        event.events = session.events;
+        event.data.fd = fd;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        writeSession(session);
+    }
+}
+
+bool Server::readSession(Session& session)
+{
+    char buffer[SERVER_READ_SIZE];
+    ssize_t length = read(session.fd, buffer, sizeof(buffer));
+    if (length < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return true;
+        }
+        closeSession(session.fd);
+        return false;
+    }
+    if (length == 0) {
+        runLines(session, true);
+        session.closing = true;
+    } else {
+        session.input.append(buffer, length);
+        runLines(session, false);
+    }
+    return writeSession(session);
+}
+
+// Runs every complete line in the session's input with std::cout captured, and queues the
+// responses as one block. A client that hangs up gets its last line run even without a
+// newline, as the prompt loop does at end of input.
+void Server::runLines(Session& session, bool hung_up)
+{
+    std::streambuf *saved = std::cout.rdbuf(&_capture);
+    size_t start = 0;
+    size_t end;
+    while (!session.closing && (end = session.input.find('\n', start)) != std::string::npos) {
+        runLine(session, std::string_view(session.input).substr(start, end - start));
+        start = end + 1;
+    }
+    if (hung_up && !session.closing && start < session.input.size()) {
+        runLine(session, std::string_view(session.input).substr(start));
+        start = session.input.size();
+    }
+    std::cout.flush();
+    std::cout.rdbuf(saved);
+
+    if (session.closing) {
+        session.input.clear();
+    } else {
+        session.input.erase(0, start);
+    }
+    session.output += _capture.str();
+    _capture.str(std::string());
+}
+
+void Server::runLine(Session& session, std::string_view line)
+{
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    if (line == "exit") {
+        session.closing = true;
+        return;
+    }
+    _run(line, _tokens, _ctx);
+    std::cout << "> ";
+}
+
+bool Server::writeSession(Session& session)
+{
+    size_t written = 0;
+    while (written < session.output.size()) {
+        ssize_t length = send(session.fd, session.output.data() + written, session.output.size() - written, MSG_NOSIGNAL);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN) {
+                break;
+            }
+            closeSession(session.fd);
+            return false;
+        }
+        written += length;
+    }
+    session.output.erase(0, written);
+    if (session.closing && session.output.empty()) {
+        closeSession(session.fd);
+        return false;
+    }
+    updateEvents(session);
+    return true;
+}
+
+// Wait for room to write while output is queued, and stop taking commands from a client
+// that is not reading its responses
+void Server::updateEvents(Session& session)
+{
+    uint32_t events = 0;
+    if (!session.closing && session.output.size() < SERVER_MAX_PENDING_OUTPUT) {
+        events |= EPOLLIN;
+    }
+    if (!session.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != session.events) {
+        struct epoll_event event = {};
+        event.events = events;
+        event.data.fd = session.fd;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, session.fd, &event);
+        session.events = events;
+    }
+}
+
+void Server::closeSession(int fd)
+{
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    _sessions.erase(fd);
+}
@@ -0,0 +1,103 @@
+#include "shm.h"
+#include "output.h"
+#include <stdio.h>
+
+SharedMemory::SharedMemory(PageTable *page_table)
+{
+    _page_table = page_table;
+}
+
+SharedMemory::~SharedMemory()
+{
+    std::map<std::string, SharedSegment*>::iterator it;
+    for (it = _segments.begin(); it != _segments.end(); it++) {
+        delete it->second;
+    }
+}
+
+// Returns NULL if a segment with this name already exists
+SharedSegment* SharedMemory::create(std::string name, DataType type, uint64_t size)
+{
+    if (_segments.count(name) > 0) {
+        return NULL;
+    }
+    int page_size = _page_table->getPageSize();
+    SharedSegment *segment = new SharedSegment();
+    segment->name = name;
+    segment->type = type;
+    segment->size = (size + page_size - 1) / page_size * page_size;
+    for (uint64_t i = 0; i < segment->size / page_size; i++) {
+        segment->frames.push_back(_page_table->allocateFrame());
+    }
+    _segments[name] = segment;
+    return segment;
+}
+
+SharedSegment* SharedMemory::find(std::string name)
+{
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    if (it == _segments.end()) {
+        return NULL;
+    }
+    return it->second;
+}
+
+void SharedMemory::destroy(std::map<std::string, SharedSegment*>::iterator it)
+{
+    SharedSegment *segment = it->second;
+    for (int i = 0; i < segment->frames.size(); i++) {
+        _page_table->releaseFrame(segment->frames[i]);
+    }
+    delete segment;
+    _segments.erase(it);
+}
+
+void SharedMemory::destroy(std::string name)
+{
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    if (it != _segments.end()) {
+        destroy(it);
+    }
+}
+
+// The caller has already unmapped the pages; this only drops the attachment
+void SharedMemory::detach(uint32_t pid, std::string name)
+{
+    std::map<std::string, SharedSegment*>::iterator it = _segments.find(name);
+    if (it == _segments.end()) {
+        return;
+    }
+    it->second->attached.erase(pid);
+    if (it->second->attached.empty()) {
+        destroy(it);
+    }
+}
+
+void SharedMemory::detachProcess(uint32_t pid)
+{
+    std::map<std::string, SharedSegment*>::iterator it = _segments.begin();
+    while (it != _segments.end()) {
+        std::map<std::string, SharedSegment*>::iterator next = it;
+        next++;
+        if (it->second->attached.erase(pid) > 0 && it->second->attached.empty()) {
+            destroy(it);
+        }
+        it = next;
+    }
+}
+
+void SharedMemory::print(std::ostream& out)
+{
+    out << " Name          | Size       | Frames     | Attached PIDs" << std::endl;
+    out << "---------------+------------+------------+---------------" << std::endl;
+    std::map<std::string, SharedSegment*>::iterator it;
+    for (it = _segments.begin(); it != _segments.end(); it++) {
+        SharedSegment *segment = it->second;
+        std::string pids;
+        std::set<uint32_t>::iterator pid;
+        for (pid = segment->attached.begin(); pid != segment->attached.end(); pid++) {
+            pids += (pids.empty() ? "" : " ") + std::to_string(*pid);
+        }
+        streamPrintf(out, " %-13s | %10llu | %10lu | %s\n", segment->name.c_str(), (unsigned long long)segment->size, segment->frames.size(), pids.c_str());
+    }
+}
@@ -0,0 +1,181 @@
+#include "stats.h"
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+
+static const char* command_names[NumStatCommands] = {
+    "create", "allocate", "set", "free", "terminate", "print", "limit", "group", "fill", "copy", "sum", "shmcreate", "shmattach", "shmdetach", "shmdestroy", "policy", "migrate", "cache", "track", "dedup", "zswap", "geometry", "stats", "unknown"
+};
+
+static const char* counter_names[NumStatCounters] = {
+    "page_table_lookups", "page_table_inserts", "page_table_deletes",
+    "frames_in_use", "free_segment_scans", "free_space_merges",
+    "remote_accesses", "pages_migrated", "cache_misses", "working_set_scans",
+    "pages_merged", "cow_breaks", "zswap_stores", "zswap_loads", "page_walk_references"
+};
+
+// Every thread's block is registered here so `stats` can sum them. Blocks of
+// threads that have exited are folded into retired.
+static std::mutex registry_lock;
+static std::vector<LiveStatsBlock*> live_blocks;
+static StatsBlock retired;
+
+static uint64_t load(const std::atomic<uint64_t>& field)
+{
+    return field.load(std::memory_order_relaxed);
+}
+
+static void accumulate(StatsBlock& dst, const LiveStatsBlock& src)
+{
+    for (int i = 0; i < NumStatCounters; i++) {
+        dst.counters[i] += src.counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < NumStatCommands; i++) {
+        dst.commands[i].count += load(src.commands[i].count);
+        dst.commands[i].total_ns += load(src.commands[i].total_ns);
+        dst.commands[i].max_ns = std::max(dst.commands[i].max_ns, load(src.commands[i].max_ns));
+        for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+            dst.commands[i].histogram[b] += load(src.commands[i].histogram[b]);
+        }
+    }
+}
+
+static void accumulate(StatsBlock& dst, const StatsBlock& src)
+{
+    for (int i = 0; i < NumStatCounters; i++) {
+        dst.counters[i] += src.counters[i];
+    }
+    for (int i = 0; i < NumStatCommands; i++) {
+        dst.commands[i].count += src.commands[i].count;
+        dst.commands[i].total_ns += src.commands[i].total_ns;
+        dst.commands[i].max_ns = std::max(dst.commands[i].max_ns, src.commands[i].max_ns);
+        for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+            dst.commands[i].histogram[b] += src.commands[i].histogram[b];
+        }
+    }
+}
+
+struct ThreadStats {
+    LiveStatsBlock block;
+
+    ThreadStats() : block()
+    {
+        std::lock_guard<std::mutex> guard(registry_lock);
+        live_blocks.push_back(&block);
+    }
+
+    ~ThreadStats()
+    {
+        std::lock_guard<std::mutex> guard(registry_lock);
+        accumulate(retired, block);
+        live_blocks.erase(std::find(live_blocks.begin(), live_blocks.end(), &block));
+    }
+};
+
+LiveStatsBlock& StatsRegistry::local()
+{
+    static thread_local ThreadStats stats;
+    return stats.block;
+}
+
+void StatsRegistry::recordCommand(StatCommand command, uint64_t elapsed_ns)
+{
+    LiveCommandStats& cmd = local().commands[command];
+    int bucket = 0;
+    uint64_t ns = elapsed_ns;
+    while (ns > 1 && bucket < STATS_HISTOGRAM_BUCKETS - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+    statsAdd<uint64_t>(cmd.count, 1);
+    statsAdd<uint64_t>(cmd.total_ns, elapsed_ns);
+    if (elapsed_ns > load(cmd.max_ns)) {
+        cmd.max_ns.store(elapsed_ns, std::memory_order_relaxed);
+    }
+    statsAdd<uint64_t>(cmd.histogram[bucket], 1);
+}
+
+StatsBlock StatsRegistry::snapshot()
+{
+    StatsBlock total;
+    memset(&total, 0, sizeof(total));
+    std::lock_guard<std::mutex> guard(registry_lock);
+    accumulate(total, retired);
+    for (int i = 0; i < live_blocks.size(); i++) {
+        accumulate(total, *live_blocks[i]);
+    }
+    return total;
+}
+
+void StatsRegistry::print(std::ostream& out)
+{
+    StatsBlock total = snapshot();
+    char line[128];
+
+    out << " Counter              | Value" << std::endl;
+    out << "----------------------+--------------" << std::endl;
+    for (int i = 0; i < NumStatCounters; i++) {
+        snprintf(line, sizeof(line), " %-20s | %12lld ", counter_names[i], (long long)total.counters[i]);
+        out << line << std::endl;
+    }
+    out << std::endl;
+    out << " Command    | Count      | Mean (ns)  | Max (ns)" << std::endl;
+    out << "------------+------------+------------+------------" << std::endl;
+    for (int i = 0; i < NumStatCommands; i++) {
+        const CommandStats& cmd = total.commands[i];
+        if (cmd.count == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line), " %-10s | %10llu | %10llu | %10llu ", command_names[i],
+                 (unsigned long long)cmd.count, (unsigned long long)(cmd.total_ns / cmd.count),
+                 (unsigned long long)cmd.max_ns);
+        out << line << std::endl;
+        for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) { // only non-empty buckets
+            if (cmd.histogram[b] > 0) {
+                snprintf(line, sizeof(line), "            | < %-12llu ns: %llu",
+                         (unsigned long long)1 << (b + 1), (unsigned long long)cmd.histogram[b]);
+                out << line << std::endl;
+            }
+        }
+    }
+}
+
+bool StatsRegistry::writeJson(const std::string& file_name)
+{
+    std::ofstream out(file_name.c_str());
+    if (!out) {
+        return false;
+    }
+    StatsBlock total = snapshot();
+
+    out << "{\n  \"counters\": {";
+    for (int i = 0; i < NumStatCounters; i++) {
+        out << (i == 0 ? "\n" : ",\n") << "    \"" << counter_names[i] << "\": " << total.counters[i];
+    }
+    out << "\n  },\n  \"commands\": {";
+    for (int i = 0; i < NumStatCommands; i++) {
+        const CommandStats& cmd = total.commands[i];
+        out << (i == 0 ? "\n" : ",\n") << "    \"" << command_names[i] << "\": {";
+        out << "\"count\": " << cmd.count << ", \"total_ns\": " << cmd.total_ns << ", \"max_ns\": " << cmd.max_ns;
+        out << ", \"histogram_log2_ns\": [";
+        for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+            out << (b == 0 ? "" : ", ") << cmd.histogram[b];
+        }
+        out << "]}";
+    }
+    out << "\n  }\n}\n";
+    return out.good();
+}
+
+const char* statCommandName(StatCommand command)
+{
+    return command_names[command];
+}
+
+const char* statCounterName(StatCounter counter)
+{
+    return counter_names[counter];
+}
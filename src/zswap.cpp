@@ -0,0 +1,99 @@
+#include "zswap.h"
+#include "lz.h"
+#include "stats.h"
+#include "output.h"
+#include <stdio.h>
+#include <chrono>
+
+ZswapPool::ZswapPool(int page_size)
+{
+    _page_size = page_size;
+    _limit = 0;
+    _pool_bytes = 0;
+    _scratch.resize(page_size);
+    _stats = ZswapStats();
+}
+
+ZswapPool::~ZswapPool()
+{
+}
+
+void ZswapPool::setLimit(size_t bytes)
+{
+    _limit = bytes;
+}
+
+bool ZswapPool::isEnabled()
+{
+    return _limit > 0;
+}
+
+bool ZswapPool::store(uint32_t pid, uint64_t page_number, const uint8_t *page)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t size = lzCompress(page, _page_size, _scratch.data(), _page_size - _page_size / 4);
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    _stats.compress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    if (size == 0) {
+        _stats.rejected++;
+        return false;
+    }
+    if (_pool_bytes + size > _limit) {
+        _stats.pool_full++;
+        return false;
+    }
+    _pages[std::make_pair(pid, page_number)].assign(_scratch.begin(), _scratch.begin() + size);
+    _pool_bytes += size;
+    _stats.stores++;
+    _stats.bytes_in += _page_size;
+    _stats.bytes_out += size;
+    STATS_INC(ZswapStores);
+    return true;
+}
+
+bool ZswapPool::load(uint32_t pid, uint64_t page_number, uint8_t *page)
+{
+    std::map<std::pair<uint32_t, uint64_t>, std::vector<uint8_t> >::iterator it = _pages.find(std::make_pair(pid, page_number));
+    if (it == _pages.end()) {
+        return false;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok = lzDecompress(it->second.data(), it->second.size(), page, _page_size);
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    _stats.decompress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    _stats.loads++;
+    STATS_INC(ZswapLoads);
+    _pool_bytes -= it->second.size();
+    _pages.erase(it);
+    return ok;
+}
+
+void ZswapPool::drop(uint32_t pid, uint64_t page_number)
+{
+    std::map<std::pair<uint32_t, uint64_t>, std::vector<uint8_t> >::iterator it = _pages.find(std::make_pair(pid, page_number));
+    if (it != _pages.end()) {
+        _pool_bytes -= it->second.size();
+        _pages.erase(it);
+    }
+}
+
+size_t ZswapPool::getStoredPages()
+{
+    return _pages.size();
+}
+
+void ZswapPool::print(std::ostream& out)
+{
+    uint64_t stored = (uint64_t)_pages.size() * _page_size;
+    streamPrintf(out, " Pool: %zu pages in %zu of %zu bytes (%.1f%% full), %llu bytes of frames freed\n", _pages.size(),
+           _pool_bytes, _limit, _limit == 0 ? 0.0 : 100.0 * _pool_bytes / _limit,
+           (unsigned long long)(stored > _pool_bytes ? stored - _pool_bytes : 0));
+    streamPrintf(out, " Compression ratio: %.2f\n", _stats.bytes_out == 0 ? 0.0 : (double)_stats.bytes_in / _stats.bytes_out);
+    streamPrintf(out, " Stores: %llu (mean %llu ns), loads: %llu (mean %llu ns)\n", (unsigned long long)_stats.stores,
+           (unsigned long long)(_stats.stores + _stats.rejected + _stats.pool_full == 0 ? 0 :
+                                _stats.compress_ns / (_stats.stores + _stats.rejected + _stats.pool_full)),
+           (unsigned long long)_stats.loads,
+           (unsigned long long)(_stats.loads == 0 ? 0 : _stats.decompress_ns / _stats.loads));
+    streamPrintf(out, " Rejected: %llu poorly compressible, %llu pool full\n", (unsigned long long)_stats.rejected,
+           (unsigned long long)_stats.pool_full);
+}
@@ -0,0 +1,38 @@
+#ifndef __CHECK_H_
+#define __CHECK_H_
+
+#include <iostream>
+#include <string>
+#include "memsim.h"
+
+// What the tests share: every failed check is reported and counted, and main returns
+// finish() once all of them have run
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+// A simulator made of `nodes` memory nodes of node_bytes each
+static void initSimulator(Simulator& sim, int nodes, uint64_t node_bytes)
+{
+    for (int i = 0; i < nodes; i++) {
+        check(sim.addNode(node_bytes, 100, 200) == SimOk, "add node");
+    }
+    check(sim.init() == SimOk, "init");
+}
+
+static int finish(const char *test_name)
+{
+    if (failures == 0) {
+        std::cout << test_name << ": ok" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+#endif // __CHECK_H_
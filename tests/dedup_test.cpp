@@ -0,0 +1,101 @@
+#include <vector>
+#include "memsim.h"
+#include "stats.h"
+#include "check.h"
+
+// Merging identical pages and breaking them again on write
+
+static int64_t cowBreaks()
+{
+    return StatsRegistry::snapshot().counters[CowBreaks];
+}
+
+// UINT64_MAX if the address is not mapped
+static uint64_t physicalAddress(Simulator& sim, uint32_t pid, uint64_t address)
+{
+    uint64_t physical;
+    return sim.translate(pid, address, &physical) == SimOk ? physical : UINT64_MAX;
+}
+
+int main()
+{
+    const int page_size = 4096;
+    const uint64_t elements = 4 * page_size / sizeof(int);
+    const uint64_t probe = elements / 2; // well inside the buffer, on a page of its own
+    Simulator sim(page_size);
+    initSimulator(sim, 2, 8 << 20);
+
+    uint32_t a, b;
+    uint64_t address_a, address_b;
+    check(sim.createProcess(1024, 1024, &a) == SimOk, "create a");
+    check(sim.createProcess(1024, 1024, &b) == SimOk, "create b");
+    check(sim.allocate(a, "buf", Int, elements, &address_a) == SimOk, "allocate a");
+    check(sim.allocate(b, "buf", Int, elements, &address_b) == SimOk, "allocate b");
+    // Every page of the buffer differs from the others, and the two buffers are identical
+    std::vector<int> values(elements);
+    for (uint64_t i = 0; i < elements; i++) {
+        values[i] = (int)i;
+    }
+    check(sim.write(a, "buf", 0, values.data(), elements) == SimOk, "write a");
+    check(sim.write(b, "buf", 0, values.data(), elements) == SimOk, "write b");
+
+    // Identical pages end up on one frame
+    check(sim.dedupPass() > 0, "dedup merges identical pages");
+    uint64_t probe_a = address_a + probe * sizeof(int);
+    uint64_t probe_b = address_b + probe * sizeof(int);
+    uint64_t shared = physicalAddress(sim, a, probe_a);
+    check(shared != UINT64_MAX && shared == physicalAddress(sim, b, probe_b), "both sharers map the merged frame");
+
+    // A write copies the frame first and leaves the other sharer as it was
+    int64_t breaks = cowBreaks();
+    int value = 42;
+    check(sim.write(a, "buf", probe, &value, 1) == SimOk, "write to a merged page");
+    int read_a = 0, read_b = 0;
+    sim.read(a, "buf", probe, &read_a, 1);
+    sim.read(b, "buf", probe, &read_b, 1);
+    check(read_a == 42, "the writer sees its write");
+    check(read_b == (int)probe, "the other sharer is unchanged");
+    check(!STATS_ENABLED || cowBreaks() == breaks + 1, "the write broke the merge once");
+    check(physicalAddress(sim, a, probe_a) != physicalAddress(sim, b, probe_b),
+          "the writer has its own frame");
+
+    // Once the other sharer is gone the last owner writes in place
+    value = (int)probe;
+    sim.write(a, "buf", probe, &value, 1);
+    check(sim.dedupPass() > 0, "dedup merges the pages again");
+    check(sim.terminate(b) == SimOk, "terminate b");
+    shared = physicalAddress(sim, a, probe_a);
+    breaks = cowBreaks();
+    value = 43;
+    sim.write(a, "buf", probe, &value, 1);
+    check(cowBreaks() == breaks, "a frame with one owner is written without a copy");
+    check(physicalAddress(sim, a, probe_a) == shared, "the last owner keeps its frame");
+
+    // A frame left with one owner is no longer merged, and frames freed by migration come
+    // back unmerged
+    check(sim.terminate(a) == SimOk, "terminate a");
+    check(sim.createProcess(1024, 1024, &a) == SimOk, "create a again");
+    check(sim.allocate(a, "buf", Int, elements, NULL) == SimOk, "allocate a again");
+    check(sim.write(a, "buf", 0, values.data(), elements) == SimOk, "write a again");
+    sim.dedupPass();
+    int merged_frames = sim.getMergedFrameCount(); // a's pages merged with each other
+    check(sim.createProcess(1024, 1024, &b) == SimOk, "create b again");
+    check(sim.allocate(b, "buf", Int, elements, NULL) == SimOk, "allocate b again");
+    check(sim.write(b, "buf", 0, values.data(), elements) == SimOk, "write b again");
+    sim.dedupPass();
+    check(sim.getMergedFrameCount() > merged_frames, "b's pages share a's frames");
+    check(sim.terminate(b) == SimOk, "terminate b again");
+    check(sim.getMergedFrameCount() == merged_frames, "frames with one owner left are not merged");
+    int moved;
+    check(sim.migrate(a, 1, &moved) == SimOk, "migrate a");
+    check(sim.getMergedFrameCount() <= merged_frames, "frames freed by migration are not merged");
+    check(sim.createProcess(1024, 1024, &b) == SimOk, "create b a third time");
+    check(sim.migrate(b, 0, &moved) == SimOk, "migrate b"); // onto the frames a left behind
+    breaks = cowBreaks();
+    check(sim.fill(b, "<TEXT>", 0, 1024, 'x') == SimOk, "fill b's text");
+    check(sim.fill(b, "<GLOBALS>", 0, 1024, 'x') == SimOk, "fill b's globals");
+    check(sim.fill(b, "<STACK>", 0, 65536, 'x') == SimOk, "fill b's stack");
+    check(cowBreaks() == breaks, "recycled frames are not copied on write");
+
+    return finish("dedup_test");
+}
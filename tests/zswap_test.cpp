@@ -0,0 +1,99 @@
+#include <vector>
+#include <string.h>
+#include "lz.h"
+#include "zswap.h"
+#include "memsim.h"
+#include "check.h"
+
+// Compression round trips and evicting pages to the zswap pool and back
+
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+static uint8_t randomByte()
+{
+    // xorshift64
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (uint8_t)random_state;
+}
+
+// Random bytes in random-length runs, which compress well
+static void fillRuns(uint8_t *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size) {
+        uint8_t value = randomByte();
+        for (size_t run = randomByte() % 32 + 1; run > 0 && i < size; run--) {
+            data[i++] = value;
+        }
+    }
+}
+
+static void roundTrip(const std::vector<uint8_t>& page, const std::string& name)
+{
+    std::vector<uint8_t> compressed(page.size() * 2);
+    std::vector<uint8_t> restored(page.size());
+    size_t size = lzCompress(page.data(), page.size(), compressed.data(), compressed.size());
+    check(size > 0, name + " page compresses");
+    check(lzDecompress(compressed.data(), size, restored.data(), restored.size()), name + " page decompresses");
+    check(restored == page, name + " page round trips");
+    check(!lzDecompress(compressed.data(), size / 2, restored.data(), restored.size()), name + " page cut short is rejected");
+}
+
+int main()
+{
+    const int page_size = 4096;
+
+    // Codec
+    std::vector<uint8_t> zero(page_size, 0);
+    std::vector<uint8_t> incompressible(page_size);
+    std::vector<uint8_t> compressible(page_size);
+    for (int i = 0; i < page_size; i++) {
+        incompressible[i] = randomByte();
+    }
+    fillRuns(compressible.data(), page_size);
+    roundTrip(zero, "zero");
+    roundTrip(incompressible, "incompressible");
+    roundTrip(compressible, "random");
+    std::vector<uint8_t> small(page_size);
+    check(lzCompress(incompressible.data(), page_size, small.data(), page_size - page_size / 4) == 0,
+          "an incompressible page does not fit in three quarters of a page");
+
+    // Pool
+    ZswapPool pool(page_size);
+    std::vector<uint8_t> restored(page_size);
+    check(!pool.store(0, 0, zero.data()), "nothing is stored while the pool is off");
+    pool.setLimit(page_size);
+    check(pool.store(0, 0, zero.data()), "store a zero page");
+    check(pool.store(0, 1, compressible.data()), "store a random page");
+    check(!pool.store(0, 2, incompressible.data()), "an incompressible page is turned away");
+    check(pool.load(0, 1, restored.data()) && restored == compressible, "load the random page back");
+    check(pool.load(0, 0, restored.data()) && restored == zero, "load the zero page back");
+    check(!pool.load(0, 0, restored.data()), "a loaded page leaves the pool");
+    check(!pool.load(0, 2, restored.data()), "a page that was never stored cannot be loaded");
+
+    // Evicting pages of a process and touching them again
+    Simulator sim(page_size);
+    initSimulator(sim, 1, 1 << 20);
+    sim.setZswapLimit(1 << 20);
+    uint32_t pid;
+    check(sim.createProcess(1024, 1024, &pid) == SimOk, "create");
+    const uint64_t elements = 8 * page_size;
+    std::vector<char> text(elements), noise(elements), values(elements);
+    fillRuns((uint8_t*)text.data(), elements);
+    for (uint64_t i = 0; i < elements; i++) {
+        noise[i] = (char)randomByte();
+    }
+    check(sim.allocate(pid, "text", Char, elements, NULL) == SimOk, "allocate text");
+    check(sim.allocate(pid, "noise", Char, elements, NULL) == SimOk, "allocate noise");
+    check(sim.write(pid, "text", 0, text.data(), elements) == SimOk, "write text");
+    check(sim.write(pid, "noise", 0, noise.data(), elements) == SimOk, "write noise");
+    int resident = sim.getFrameCount();
+    check(sim.reclaimFrames(resident) > 0, "cold pages are compressed");
+    check(sim.getFrameCount() < resident, "compressing pages frees their frames");
+    check(sim.read(pid, "text", 0, values.data(), elements) == SimOk && values == text, "compressed pages read back intact");
+    check(sim.read(pid, "noise", 0, values.data(), elements) == SimOk && values == noise, "incompressible pages stay intact");
+
+    return finish("zswap_test");
+}